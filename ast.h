@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
@@ -7,6 +8,7 @@
 class ASTNode {
 public:
     virtual ~ASTNode() = default;
+    size_t offset = 0; // byte offset of a statement in its source file; see LineIndex
 };
 
 // Expression node
@@ -55,16 +57,47 @@ public:
     std::unique_ptr<ExprNode> condition;
     std::unique_ptr<ASTNode> increment;
     std::vector<std::unique_ptr<ASTNode>> body;
+    bool parallel = false; // parfor: iterations run on the thread pool
     ForNode(std::unique_ptr<ASTNode> i, std::unique_ptr<ExprNode> c, std::unique_ptr<ASTNode> inc)
         : init(std::move(i)), condition(std::move(c)), increment(std::move(inc)) {}
 };
 
-// Switch statement
+// for x in expr { ... }: iterates the elements of a pack, the rows of a matrix or the
+// lines of lines(path)
+class ForInNode : public ASTNode {
+public:
+    std::string var;
+    std::unique_ptr<ExprNode> iterable;
+    std::vector<std::unique_ptr<ASTNode>> body;
+    ForInNode(const std::string& v, std::unique_ptr<ExprNode> it) : var(v), iterable(std::move(it)) {}
+};
+
+// switch (expr) { case 1, 2: ... case "on": ... default: ... } runs the statements of the
+// one case with a label equal to the value, or of default; there is no fall-through.
+// Labels are number and text literals, unique within the switch.
 class SwitchNode : public ASTNode {
 public:
+    struct Case {
+        std::vector<std::unique_ptr<ExprNode>> labels; // NumberNode or StringNode
+        std::vector<std::unique_ptr<ASTNode>> body;
+    };
     std::unique_ptr<ExprNode> expr;
-    // Add case/branch structure as needed
+    std::vector<Case> cases;
+    std::vector<std::unique_ptr<ASTNode>> defaultBody;
     SwitchNode(std::unique_ptr<ExprNode> e) : expr(std::move(e)) {}
+    // Builds the dispatch tables from the labels; call once the cases are complete
+    void buildDispatch();
+    // Index into cases of the case matching a value, or -1 for default
+    int find(double v) const;
+    int find(const std::string& v) const;
+
+private:
+    // Dense integer labels index a jump table from tableBase; other numbers and all
+    // text go through hash maps
+    double tableBase = 0;
+    std::vector<int> table;
+    std::unordered_map<double, int> numberCases;
+    std::unordered_map<std::string, int> textCases;
 };
 
 // Array node (for array literals)
@@ -120,6 +153,16 @@ public:
         : array(std::move(arr)), index(std::move(idx)) {}
 };
 
+// Slice: array[start:end]; either bound may be left out (null)
+class SliceNode : public ExprNode {
+public:
+    std::unique_ptr<ExprNode> array;
+    std::unique_ptr<ExprNode> start;
+    std::unique_ptr<ExprNode> end;
+    SliceNode(std::unique_ptr<ExprNode> arr, std::unique_ptr<ExprNode> s, std::unique_ptr<ExprNode> e)
+        : array(std::move(arr)), start(std::move(s)), end(std::move(e)) {}
+};
+
 // Function call: len(array)
 class CallNode : public ExprNode {
 public:
@@ -129,6 +172,27 @@ public:
         : func(f), args(std::move(a)) {}
 };
 
+// spawn f(args): starts f as a task and evaluates to the task handle
+class SpawnNode : public ExprNode {
+public:
+    std::unique_ptr<CallNode> call;
+    SpawnNode(std::unique_ptr<CallNode> c) : call(std::move(c)) {}
+};
+
+// await task: waits for the task and evaluates to its return value
+class AwaitNode : public ExprNode {
+public:
+    std::unique_ptr<ExprNode> task;
+    AwaitNode(std::unique_ptr<ExprNode> t) : task(std::move(t)) {}
+};
+
+// Module import: #use <name>
+class UseNode : public ASTNode {
+public:
+    std::string module;
+    UseNode(const std::string& m) : module(m) {}
+};
+
 // Function definition
 class FunctionNode : public ASTNode {
 public:
@@ -144,4 +208,4 @@ class ReturnNode : public ASTNode {
 public:
     std::unique_ptr<ExprNode> value;
     ReturnNode(std::unique_ptr<ExprNode> v) : value(std::move(v)) {}
-}; 
\ No newline at end of file
+};
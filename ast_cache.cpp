@@ -0,0 +1,424 @@
+#include "ast_cache.h"
+#include "mapped_file.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[4] = {'Z', 'E', 'N', 'C'};
+
+// One tag per node class; values are part of the file format
+enum class Tag : uint8_t {
+    Null, VarDecl, Print, If, While, For, Switch, Array, Pointer, Binary,
+    Identifier, Number, String, Index, Call, Spawn, Await, Function, Return, Use, ForIn, Slice
+};
+
+class Writer {
+public:
+    std::string buffer;
+    template <typename T> void put(T v) { buffer.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void str(const std::string& s) {
+        put(static_cast<uint32_t>(s.size()));
+        buffer += s;
+    }
+    // Every node but Null is followed by its source offset
+    void tag(Tag t, const ASTNode* n = nullptr) {
+        put(static_cast<uint8_t>(t));
+        if (n) put(static_cast<uint32_t>(n->offset));
+    }
+    void node(const ASTNode* n);
+    void nodes(const std::vector<std::unique_ptr<ASTNode>>& list) {
+        put(static_cast<uint32_t>(list.size()));
+        for (const auto& n : list) node(n.get());
+    }
+    template <typename T> void exprs(const std::vector<std::unique_ptr<T>>& list) {
+        put(static_cast<uint32_t>(list.size()));
+        for (const auto& n : list) node(n.get());
+    }
+};
+
+void Writer::node(const ASTNode* n) {
+    if (!n) {
+        tag(Tag::Null);
+    } else if (auto var = dynamic_cast<const VarDeclNode*>(n)) {
+        tag(Tag::VarDecl, n);
+        str(var->name);
+        node(var->value.get());
+    } else if (auto print = dynamic_cast<const PrintNode*>(n)) {
+        tag(Tag::Print, n);
+        node(print->expr.get());
+    } else if (auto ifNode = dynamic_cast<const IfNode*>(n)) {
+        tag(Tag::If, n);
+        node(ifNode->condition.get());
+        nodes(ifNode->thenBranch);
+        nodes(ifNode->elseBranch);
+    } else if (auto whileNode = dynamic_cast<const WhileNode*>(n)) {
+        tag(Tag::While, n);
+        node(whileNode->condition.get());
+        nodes(whileNode->body);
+    } else if (auto forNode = dynamic_cast<const ForNode*>(n)) {
+        tag(Tag::For, n);
+        put(static_cast<uint8_t>(forNode->parallel));
+        node(forNode->init.get());
+        node(forNode->condition.get());
+        node(forNode->increment.get());
+        nodes(forNode->body);
+    } else if (auto forIn = dynamic_cast<const ForInNode*>(n)) {
+        tag(Tag::ForIn, n);
+        str(forIn->var);
+        node(forIn->iterable.get());
+        nodes(forIn->body);
+    } else if (auto sw = dynamic_cast<const SwitchNode*>(n)) {
+        tag(Tag::Switch, n);
+        node(sw->expr.get());
+        put(static_cast<uint32_t>(sw->cases.size()));
+        for (const auto& branch : sw->cases) {
+            exprs(branch.labels);
+            nodes(branch.body);
+        }
+        nodes(sw->defaultBody);
+    } else if (auto arr = dynamic_cast<const ArrayNode*>(n)) {
+        tag(Tag::Array, n);
+        exprs(arr->elements);
+    } else if (auto ptr = dynamic_cast<const PointerNode*>(n)) {
+        tag(Tag::Pointer, n);
+        node(ptr->pointee.get());
+    } else if (auto bin = dynamic_cast<const BinaryExprNode*>(n)) {
+        tag(Tag::Binary, n);
+        str(bin->op);
+        node(bin->left.get());
+        node(bin->right.get());
+    } else if (auto id = dynamic_cast<const IdentifierNode*>(n)) {
+        tag(Tag::Identifier, n);
+        str(id->name);
+    } else if (auto num = dynamic_cast<const NumberNode*>(n)) {
+        tag(Tag::Number, n);
+        str(num->value);
+    } else if (auto s = dynamic_cast<const StringNode*>(n)) {
+        tag(Tag::String, n);
+        str(s->value);
+    } else if (auto idx = dynamic_cast<const IndexNode*>(n)) {
+        tag(Tag::Index, n);
+        node(idx->array.get());
+        node(idx->index.get());
+    } else if (auto slice = dynamic_cast<const SliceNode*>(n)) {
+        tag(Tag::Slice, n);
+        node(slice->array.get());
+        node(slice->start.get());
+        node(slice->end.get());
+    } else if (auto call = dynamic_cast<const CallNode*>(n)) {
+        tag(Tag::Call, n);
+        str(call->func);
+        exprs(call->args);
+    } else if (auto spawn = dynamic_cast<const SpawnNode*>(n)) {
+        tag(Tag::Spawn, n);
+        node(spawn->call.get());
+    } else if (auto await = dynamic_cast<const AwaitNode*>(n)) {
+        tag(Tag::Await, n);
+        node(await->task.get());
+    } else if (auto func = dynamic_cast<const FunctionNode*>(n)) {
+        tag(Tag::Function, n);
+        str(func->name);
+        put(static_cast<uint32_t>(func->params.size()));
+        for (const auto& p : func->params) str(p);
+        nodes(func->body);
+    } else if (auto ret = dynamic_cast<const ReturnNode*>(n)) {
+        tag(Tag::Return, n);
+        node(ret->value.get());
+    } else if (auto use = dynamic_cast<const UseNode*>(n)) {
+        tag(Tag::Use, n);
+        str(use->module);
+    } else {
+        throw std::runtime_error("zenc: cannot serialize unknown AST node");
+    }
+}
+
+// Bounds-checked reader over the mapped file; any overrun means a corrupt cache
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p(data), end(data + size) {}
+    template <typename T> T get() {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+    std::string str() {
+        uint32_t n = get<uint32_t>();
+        need(n);
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+    std::unique_ptr<ASTNode> node();
+    std::unique_ptr<ASTNode> nodeOf(Tag t);
+    std::unique_ptr<ExprNode> expr() {
+        auto n = node();
+        if (n && !dynamic_cast<ExprNode*>(n.get())) throw std::runtime_error("zenc: expected expression");
+        return std::unique_ptr<ExprNode>(static_cast<ExprNode*>(n.release()));
+    }
+    std::vector<std::unique_ptr<ASTNode>> nodes() {
+        std::vector<std::unique_ptr<ASTNode>> list(get<uint32_t>());
+        for (auto& n : list) n = node();
+        return list;
+    }
+    std::vector<std::unique_ptr<ExprNode>> exprs() {
+        std::vector<std::unique_ptr<ExprNode>> list(get<uint32_t>());
+        for (auto& n : list) n = expr();
+        return list;
+    }
+    bool atEnd() const { return p == end; }
+private:
+    const char* p;
+    const char* end;
+    void need(size_t n) {
+        if (static_cast<size_t>(end - p) < n) throw std::runtime_error("zenc: truncated cache");
+    }
+};
+
+std::unique_ptr<ASTNode> Reader::node() {
+    auto t = static_cast<Tag>(get<uint8_t>());
+    if (t == Tag::Null) return nullptr;
+    auto offset = get<uint32_t>();
+    auto n = nodeOf(t);
+    n->offset = offset;
+    return n;
+}
+
+std::unique_ptr<ASTNode> Reader::nodeOf(Tag t) {
+    switch (t) {
+        case Tag::Null: return nullptr;
+        case Tag::VarDecl: {
+            auto name = str();
+            return std::make_unique<VarDeclNode>(name, expr());
+        }
+        case Tag::Print: return std::make_unique<PrintNode>(expr());
+        case Tag::If: {
+            auto ifNode = std::make_unique<IfNode>(expr());
+            ifNode->thenBranch = nodes();
+            ifNode->elseBranch = nodes();
+            return ifNode;
+        }
+        case Tag::While: {
+            auto whileNode = std::make_unique<WhileNode>(expr());
+            whileNode->body = nodes();
+            return whileNode;
+        }
+        case Tag::For: {
+            bool parallel = get<uint8_t>() != 0;
+            auto init = node();
+            auto condition = expr();
+            auto increment = node();
+            auto forNode = std::make_unique<ForNode>(std::move(init), std::move(condition), std::move(increment));
+            forNode->parallel = parallel;
+            forNode->body = nodes();
+            return forNode;
+        }
+        case Tag::ForIn: {
+            auto var = str();
+            auto forIn = std::make_unique<ForInNode>(var, expr());
+            forIn->body = nodes();
+            return forIn;
+        }
+        case Tag::Switch: {
+            auto switchNode = std::make_unique<SwitchNode>(expr());
+            switchNode->cases.resize(get<uint32_t>());
+            for (auto& branch : switchNode->cases) {
+                branch.labels = exprs();
+                for (const auto& label : branch.labels) {
+                    if (!dynamic_cast<NumberNode*>(label.get()) && !dynamic_cast<StringNode*>(label.get())) {
+                        throw std::runtime_error("zenc: case label is not a literal");
+                    }
+                }
+                branch.body = nodes();
+            }
+            switchNode->defaultBody = nodes();
+            switchNode->buildDispatch();
+            return switchNode;
+        }
+        case Tag::Array: return std::make_unique<ArrayNode>(exprs());
+        case Tag::Pointer: return std::make_unique<PointerNode>(expr());
+        case Tag::Binary: {
+            auto op = str();
+            auto left = expr();
+            return std::make_unique<BinaryExprNode>(op, std::move(left), expr());
+        }
+        case Tag::Identifier: return std::make_unique<IdentifierNode>(str());
+        case Tag::Number: return std::make_unique<NumberNode>(str());
+        case Tag::String: return std::make_unique<StringNode>(str());
+        case Tag::Index: {
+            auto array = expr();
+            return std::make_unique<IndexNode>(std::move(array), expr());
+        }
+        case Tag::Slice: {
+            auto array = expr();
+            auto start = expr();
+            return std::make_unique<SliceNode>(std::move(array), std::move(start), expr());
+        }
+        case Tag::Call: {
+            auto func = str();
+            return std::make_unique<CallNode>(func, exprs());
+        }
+        case Tag::Spawn: {
+            auto call = node();
+            if (!dynamic_cast<CallNode*>(call.get())) throw std::runtime_error("zenc: spawn without call");
+            return std::make_unique<SpawnNode>(std::unique_ptr<CallNode>(static_cast<CallNode*>(call.release())));
+        }
+        case Tag::Await: return std::make_unique<AwaitNode>(expr());
+        case Tag::Function: {
+            auto name = str();
+            std::vector<std::string> params(get<uint32_t>());
+            for (auto& p : params) p = str();
+            auto func = std::make_unique<FunctionNode>(name, std::move(params));
+            func->body = nodes();
+            return func;
+        }
+        case Tag::Return: return std::make_unique<ReturnNode>(expr());
+        case Tag::Use: return std::make_unique<UseNode>(str());
+    }
+    throw std::runtime_error("zenc: unknown node tag");
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<const Program> loadCache(const std::string& path, uint64_t sourceHash, const std::string& baseDir) {
+    try {
+        auto file = MappedFile::open(path);
+        return deserializeProgram(file->data(), file->size(), sourceHash, baseDir);
+    } catch (const std::exception&) {
+        return nullptr; // missing or corrupt cache: recompile and overwrite it
+    }
+}
+
+void writeCache(const std::string& path, const std::string& bytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    // Write a temporary and rename it over the cache so readers never see half a file
+    std::string tmp = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file) {
+            file.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) std::remove(tmp.c_str());
+}
+
+} // namespace
+
+// Hash of the lexer, parser and AST sources, generated by the build; builds without it
+// rely on ZENC_VERSION alone
+#if __has_include("zenc_salt.h")
+#include "zenc_salt.h"
+#else
+#define ZENC_SOURCE_HASH ""
+#endif
+
+constexpr uint64_t buildSalt() {
+    uint64_t h = 14695981039346656037ull ^ ZENC_VERSION;
+    for (char c : ZENC_SOURCE_HASH) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// FNV-1a over the source text, salted with the format version and the parser sources
+uint64_t hashSource(const std::string& source) {
+    uint64_t h = buildSalt();
+    for (unsigned char c : source) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string serializeProgram(const Program& program, uint64_t sourceHash) {
+    Writer w;
+    w.buffer.append(MAGIC, sizeof(MAGIC));
+    w.put(ZENC_VERSION);
+    w.put(sourceHash);
+    w.nodes(program.ast);
+    return std::move(w.buffer);
+}
+
+std::shared_ptr<const Program> deserializeProgram(const char* data, size_t size, uint64_t sourceHash, const std::string& baseDir) {
+    if (size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) return nullptr;
+    Reader r(data + sizeof(MAGIC), size - sizeof(MAGIC));
+    if (r.get<uint32_t>() != ZENC_VERSION || r.get<uint64_t>() != sourceHash) return nullptr;
+    auto ast = r.nodes();
+    if (!r.atEnd()) throw std::runtime_error("zenc: trailing data");
+    return std::make_shared<const Program>(std::move(ast), baseDir);
+}
+
+std::string cacheDir() {
+    if (const char* dir = std::getenv("ZEN_CACHE_DIR")) return dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::string(xdg) + "/zen";
+    if (const char* home = std::getenv("HOME"); home && *home) return std::string(home) + "/.cache/zen";
+    return "";
+}
+
+std::string cachePathFor(const std::string& sourcePath) {
+    std::string dir = cacheDir();
+    if (dir.empty()) return "";
+    std::error_code ec;
+    auto source = std::filesystem::weakly_canonical(sourcePath, ec);
+    if (ec) source = std::filesystem::absolute(sourcePath, ec);
+    // The script's name keeps the directory readable; the hash of its full path keeps
+    // scripts of the same name apart
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : source.string()) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return dir + "/" + source.stem().string() + "-" + hex + ".zenc";
+}
+
+std::shared_ptr<const Program> compileFileCached(const std::string& path, CompileStats* stats) {
+    CompileStats local;
+    CompileStats& s = stats ? *stats : local;
+    auto start = std::chrono::steady_clock::now();
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Could not open file: " + path);
+    file.seekg(0, std::ios::end);
+    std::string source(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&source[0], static_cast<std::streamsize>(source.size()));
+    uint64_t hash = hashSource(source);
+    s.readMs = msSince(start);
+
+    std::string cachePath = cachePathFor(path);
+    std::string baseDir = std::filesystem::path(path).parent_path().string();
+    start = std::chrono::steady_clock::now();
+    if (cachePath.empty()) {
+        auto program = compile(source, baseDir);
+        s.compileMs = msSince(start);
+        return program;
+    }
+    if (auto program = loadCache(cachePath, hash, baseDir)) {
+        s.cacheHit = true;
+        s.compileMs = msSince(start);
+        return program;
+    }
+    auto program = compile(source, baseDir);
+    s.cacheHit = false;
+    s.compileMs = msSince(start);
+    start = std::chrono::steady_clock::now();
+    writeCache(cachePath, serializeProgram(*program, hash));
+    s.writeMs = msSince(start);
+    return program;
+}
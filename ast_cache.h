@@ -0,0 +1,32 @@
+#pragma once
+#include "program.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Compiled-program cache. A script foo.mylang is cached as foo-<hash of its path>.zenc
+// in $ZEN_CACHE_DIR, else $XDG_CACHE_HOME/zen, else ~/.cache/zen; an empty ZEN_CACHE_DIR
+// turns the cache off. A cache is a compact pre-order encoding of the AST stamped with a
+// hash of the source text and of the lexer, parser and AST sources zen was built from,
+// so a build whose parser differs starts from fresh caches.
+//
+// Bump ZENC_VERSION whenever an AST node gains, loses or reorders a field, or the
+// encoding below changes; caches written by other versions are then ignored.
+constexpr uint32_t ZENC_VERSION = 6;
+
+struct CompileStats {
+    bool cacheHit = false;
+    double readMs = 0;    // reading and hashing the source
+    double compileMs = 0; // loading the cache on a hit, lexing and parsing on a miss
+    double writeMs = 0;   // writing a fresh cache after a miss
+};
+
+uint64_t hashSource(const std::string& source);
+std::string serializeProgram(const Program& program, uint64_t sourceHash);
+// Returns nullptr if data is not a cache for a source with this hash and ZENC_VERSION
+std::shared_ptr<const Program> deserializeProgram(const char* data, size_t size, uint64_t sourceHash, const std::string& baseDir);
+// Where the cache for the script at sourcePath lives; empty when caching is off
+std::string cachePathFor(const std::string& sourcePath);
+// compileFile() through the cache: loads path's .zenc when it matches the source and
+// rewrites it otherwise. A cache that cannot be read or written is silently skipped.
+std::shared_ptr<const Program> compileFileCached(const std::string& path, CompileStats* stats = nullptr);
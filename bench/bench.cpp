@@ -0,0 +1,262 @@
+// zen_bench: times lexing, parsing and running a corpus of workloads separately, and
+// writes the results as JSON. Given the JSON of an earlier run as a baseline, it also
+// lists the phases that got slower and exits with status 2 if any did.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "readers.h"
+#include "thread_pool.h"
+#include "zen.h"
+
+#ifndef ZEN_BENCH_DIR
+#define ZEN_BENCH_DIR "bench"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The default corpus, in bench/
+const char* const CORPUS[] = {"fib", "loops", "strings", "packs", "dispatch", "sort"};
+// Size of the generated source for the lexing-only workload
+constexpr size_t LARGE_SOURCE_BYTES = 4 * 1024 * 1024;
+// A phase must be this much slower than the baseline, relatively and absolutely, to count
+constexpr double DEFAULT_THRESHOLD = 0.10;
+constexpr double NOISE_MS = 0.5;
+
+struct Workload {
+    std::string name;
+    std::string source;
+    std::string dir;  // where its #use modules are looked for
+    bool run = true;  // false: lex and parse only
+};
+
+struct Phase {
+    std::string name;
+    std::vector<double> ms;
+    double min() const { return *std::min_element(ms.begin(), ms.end()); }
+    double mean() const {
+        double total = 0;
+        for (double m : ms) total += m;
+        return total / ms.size();
+    }
+    double median() const {
+        std::vector<double> sorted = ms;
+        std::sort(sorted.begin(), sorted.end());
+        size_t mid = sorted.size() / 2;
+        return sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+    }
+};
+
+struct Result {
+    const Workload* workload;
+    std::vector<Phase> phases;
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot read " + path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+// Many small functions with the usual mix of tokens: identifiers, numbers, strings,
+// operators, brackets and comments
+std::string largeSource(size_t bytes) {
+    std::string source;
+    for (size_t i = 0; source.size() < bytes; ++i) {
+        std::string n = std::to_string(i);
+        source += "// generated function " + n + "\n";
+        source += "func f" + n + "(a, b) {\n";
+        source += "    let s = \"text " + n + "\";\n";
+        source += "    let xs = [1, 2.5, a, b, " + n + "];\n";
+        source += "    if (a < b || a == " + n + ") {\n";
+        source += "        s = s + \"x\";\n";
+        source += "    }\n";
+        source += "    while (a > 0) {\n";
+        source += "        a = a - 1;\n";
+        source += "    }\n";
+        source += "    return a * b + xs[2] / 3.25;\n";
+        source += "}\n";
+    }
+    return source;
+}
+
+double since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+Result measure(const Workload& w, int warmup, int iterations) {
+    Result result{&w, {{"lex_ms", {}}, {"parse_ms", {}}}};
+    if (w.run) result.phases.push_back({"run_ms", {}});
+    for (int i = 0; i < warmup + iterations; ++i) {
+        auto start = Clock::now();
+        Lexer lexer(w.source);
+        auto tokens = lexer.tokenize();
+        double lexMs = since(start);
+
+        start = Clock::now();
+        Parser parser(tokens);
+        auto program = std::make_shared<const Program>(parser.parse(), w.dir);
+        double parseMs = since(start);
+
+        double runMs = 0;
+        if (w.run) {
+            start = Clock::now();
+            std::ostringstream out;
+            zen::Context context(program, out);
+            context.run();
+            runMs = since(start);
+        }
+        if (i < warmup) continue;
+        result.phases[0].ms.push_back(lexMs);
+        result.phases[1].ms.push_back(parseMs);
+        if (w.run) result.phases[2].ms.push_back(runMs);
+    }
+    return result;
+}
+
+std::string quoted(const std::string& s) {
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') q += '\\';
+        q += c;
+    }
+    return q + "\"";
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results, int warmup, int iterations) {
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"format\": 1,\n  \"iterations\": " << iterations << ",\n  \"warmup\": " << warmup
+        << ",\n  \"threads\": " << ThreadPool::instance().size() << ",\n  \"workloads\": {";
+    for (size_t r = 0; r < results.size(); ++r) {
+        const Result& result = results[r];
+        out << (r ? ",\n" : "\n") << "    " << quoted(result.workload->name) << ": {\n";
+        out << "      \"bytes\": " << result.workload->source.size();
+        for (const Phase& phase : result.phases) {
+            out << ",\n      " << quoted(phase.name) << ": {\"min\": " << phase.min() << ", \"median\": "
+                << phase.median() << ", \"mean\": " << phase.mean() << "}";
+        }
+        out << "\n    }";
+    }
+    out << "\n  }\n}\n";
+}
+
+const Value* member(const Value& v, const std::string& key) {
+    auto map = std::get_if<Map>(&v);
+    return map ? map->find(key) : nullptr;
+}
+
+// Prints each phase next to its baseline median; returns how many got slower
+int compare(const std::vector<Result>& results, const Value& baseline, double threshold) {
+    const Value* workloads = member(baseline, "workloads");
+    if (!workloads) throw std::runtime_error("baseline has no \"workloads\"");
+    int regressions = 0;
+    std::cerr << std::fixed << std::setprecision(2);
+    std::cerr << std::left << std::setw(20) << "workload" << std::setw(10) << "phase" << std::right
+              << std::setw(12) << "base ms" << std::setw(12) << "now ms" << std::setw(10) << "change" << "\n";
+    for (const Result& result : results) {
+        const Value* base = member(*workloads, result.workload->name);
+        for (const Phase& phase : result.phases) {
+            const Value* stats = base ? member(*base, phase.name) : nullptr;
+            const Value* median = stats ? member(*stats, "median") : nullptr;
+            auto before = median ? std::get_if<double>(median) : nullptr;
+            if (!before) continue;
+            double now = phase.median();
+            double change = *before > 0 ? now / *before - 1 : 0;
+            bool slower = change > threshold && now - *before > NOISE_MS;
+            regressions += slower;
+            std::cerr << std::left << std::setw(20) << result.workload->name << std::setw(10)
+                      << phase.name.substr(0, phase.name.size() - 3) << std::right << std::setw(12) << *before
+                      << std::setw(12) << now << std::setw(9) << std::showpos << change * 100 << std::noshowpos
+                      << "%" << (slower ? "  SLOWER" : "") << "\n";
+        }
+    }
+    return regressions;
+}
+
+int usage(const char* self) {
+    std::cerr << "Usage: " << self << " [--iterations N] [--warmup N] [--out file.json]\n"
+              << "       [--baseline file.json] [--threshold percent] [script.mylang ...]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 5;
+    int warmup = 1;
+    double threshold = DEFAULT_THRESHOLD;
+    std::string outPath, baselinePath;
+    std::vector<std::string> scripts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::atof(argv[++i]) / 100;
+        } else if (arg.rfind("--", 0) == 0) {
+            return usage(argv[0]);
+        } else {
+            scripts.push_back(arg);
+        }
+    }
+
+    try {
+        bool corpus = scripts.empty();
+        if (corpus) {
+            for (const char* name : CORPUS) scripts.push_back(std::string(ZEN_BENCH_DIR) + "/" + name + ".mylang");
+        }
+        std::vector<Workload> workloads;
+        for (const auto& script : scripts) {
+            std::filesystem::path path(script);
+            workloads.push_back({path.stem().string(), readFile(script), path.parent_path().string()});
+        }
+        if (corpus) workloads.push_back({"lex_large", largeSource(LARGE_SOURCE_BYTES), ZEN_BENCH_DIR, false});
+
+        std::vector<Result> results;
+        for (const auto& w : workloads) {
+            std::cerr << "bench: " << w.name << "\n";
+            results.push_back(measure(w, warmup, iterations));
+        }
+
+        if (outPath.empty()) {
+            writeJson(std::cout, results, warmup, iterations);
+        } else {
+            std::ofstream out(outPath);
+            if (!out) throw std::runtime_error("cannot write " + outPath);
+            writeJson(out, results, warmup, iterations);
+        }
+
+        if (!baselinePath.empty()) {
+            std::string text = readFile(baselinePath);
+            int slower = compare(results, parseJson(text), threshold);
+            if (slower) {
+                std::cerr << "bench: " << slower << " phase(s) slower than the baseline\n";
+                return 2;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
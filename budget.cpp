@@ -0,0 +1,117 @@
+#include "budget.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace budget {
+
+namespace {
+
+thread_local std::shared_ptr<Meter> current;
+
+std::string sizeText(size_t bytes) {
+    if (bytes % (1024 * 1024) == 0) return std::to_string(bytes / (1024 * 1024)) + " MB";
+    return std::to_string(bytes) + " bytes";
+}
+
+BudgetExceeded outOfMemory(size_t cap) {
+    return BudgetExceeded(BudgetExceeded::Kind::Memory, "memory limit of " + sizeText(cap) + " exceeded");
+}
+
+BudgetExceeded pastDeadline(double ms) {
+    return BudgetExceeded(BudgetExceeded::Kind::Deadline, "deadline of " + std::to_string(static_cast<long long>(ms)) + " ms exceeded");
+}
+
+const char* threadStackFloor() {
+#if defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) return nullptr;
+    void* low = nullptr;
+    size_t size = 0;
+    pthread_attr_getstack(&attr, &low, &size);
+    pthread_attr_destroy(&attr);
+    if (!low || size < 2 * STACK_RESERVE) return nullptr;
+    return static_cast<const char*>(low) + STACK_RESERVE;
+#else
+    return nullptr;
+#endif
+}
+
+} // namespace
+
+const char*& stackFloor() {
+    thread_local const char* floor = threadStackFloor();
+    return floor;
+}
+
+BudgetExceeded tooDeep(uint32_t depth, uint32_t limit) {
+    if (limit) return BudgetExceeded(BudgetExceeded::Kind::Depth, "call depth limit of " + std::to_string(limit) + " exceeded");
+    return BudgetExceeded(BudgetExceeded::Kind::Depth, "out of stack after " + std::to_string(depth) + " nested calls");
+}
+
+Meter::Meter(const Limits& limits) : limits_(limits) {
+    restart();
+}
+
+void Meter::restart() {
+    fuelLeft = limits_.fuel;
+    deadline = Clock::now() + std::chrono::microseconds(static_cast<long long>(limits_.deadlineMs * 1000));
+}
+
+uint32_t Meter::draw(uint32_t n) {
+    if (limits_.deadlineMs > 0 && Clock::now() >= deadline) {
+        throw pastDeadline(limits_.deadlineMs);
+    }
+    if (!limits_.fuel) return n;
+    uint64_t left = fuelLeft.load(std::memory_order_relaxed);
+    uint64_t take;
+    do {
+        take = std::min<uint64_t>(left, n);
+        if (take == 0) {
+            throw BudgetExceeded(BudgetExceeded::Kind::Fuel,
+                                 "fuel of " + std::to_string(limits_.fuel) + " steps used up");
+        }
+    } while (!fuelLeft.compare_exchange_weak(left, left - take, std::memory_order_relaxed));
+    return static_cast<uint32_t>(take);
+}
+
+void Meter::charge(std::ptrdiff_t bytes) {
+    int64_t now = used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0 && limits_.memoryBytes && now > static_cast<int64_t>(limits_.memoryBytes)) {
+        used.fetch_sub(bytes, std::memory_order_relaxed);
+        throw outOfMemory(limits_.memoryBytes);
+    }
+}
+
+void Meter::checkWait(double ms) const {
+    if (limits_.deadlineMs > 0 && Clock::now() + std::chrono::microseconds(static_cast<long long>(ms * 1000)) > deadline) {
+        throw pastDeadline(limits_.deadlineMs);
+    }
+}
+
+void Meter::checkRoom(size_t bytes) const {
+    if (!limits_.memoryBytes) return;
+    if (used.load(std::memory_order_relaxed) + static_cast<int64_t>(bytes) > static_cast<int64_t>(limits_.memoryBytes)) {
+        throw outOfMemory(limits_.memoryBytes);
+    }
+}
+
+const std::shared_ptr<Meter>& active() {
+    return current;
+}
+
+void checkRoom(size_t bytes) {
+    if (current) current->checkRoom(bytes);
+}
+
+Scope::Scope(const std::shared_ptr<Meter>& meter) : previous(std::move(current)) {
+    current = meter;
+}
+
+Scope::~Scope() {
+    current = std::move(previous);
+}
+
+} // namespace budget
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Limits on what one run of a script may use, for scripts run on someone else's behalf.
+// Fuel is spent one unit per loop iteration and per function call; interpreters take it
+// from the shared meter in batches and read the clock only when a batch runs out, so the
+// cost per iteration is a decrement. Memory counts the live bytes of packs, maps and
+// matrices made while the meter is active; text is checked against the room left when it
+// is built but not counted. Fuel does not bound how deep calls nest, so besides the
+// optional depth limit every call checks that the native stack has room left.
+namespace budget {
+
+// Zero means no limit
+struct Limits {
+    uint64_t fuel = 0;        // loop iterations and function calls
+    size_t memoryBytes = 0;   // live bytes held by packs, maps and matrices
+    double deadlineMs = 0;    // wall-clock time from the start of run() or call()
+    uint32_t callDepth = 0;   // function calls in progress at once
+    // Whether a Meter is needed; the depth limit is kept by the interpreter itself
+    bool any() const { return fuel || memoryBytes || deadlineMs > 0; }
+};
+
+} // namespace budget
+
+// Thrown when a script runs out of fuel, memory, time or stack. Scripts cannot catch it.
+struct BudgetExceeded : std::runtime_error {
+    enum class Kind { Fuel, Memory, Deadline, Depth };
+    Kind kind;
+    BudgetExceeded(Kind kind, const std::string& message) : std::runtime_error(message), kind(kind) {}
+};
+
+namespace budget {
+
+// Ticks an interpreter runs between visits to the meter
+constexpr uint32_t CHECK_INTERVAL = 256;
+
+// Native stack kept free below the deepest call, for the builtins it runs and unwinding
+constexpr size_t STACK_RESERVE = 256 * 1024;
+
+// Lowest address calls on this thread may reach, or null where the stack is unknown.
+// Tasks run on a stack of their own and point it there while they run.
+const char*& stackFloor();
+
+// True once the calling thread is within STACK_RESERVE of the end of its stack
+inline bool stackLow() {
+    char here;
+    const char* floor = stackFloor();
+    return floor && reinterpret_cast<uintptr_t>(&here) < reinterpret_cast<uintptr_t>(floor);
+}
+
+// The error for calls nested depth deep; limit is the configured one, or 0 when the
+// native stack ran out first
+BudgetExceeded tooDeep(uint32_t depth, uint32_t limit);
+
+// What remains of one interpreter's limits, shared with its parfor workers
+class Meter {
+public:
+    explicit Meter(const Limits& limits);
+    const Limits& limits() const { return limits_; }
+    // Refills the fuel and restarts the deadline clock; memory in use carries over
+    void restart();
+    // Takes up to n units of fuel and checks the deadline. Returns how many ticks may run
+    // before the next call; throws BudgetExceeded when fuel or time has run out.
+    uint32_t draw(uint32_t n);
+    // Adds (or, when negative, releases) live bytes; growth past the cap is refused
+    void charge(std::ptrdiff_t bytes);
+    // Throws if bytes more would not fit under the cap
+    void checkRoom(size_t bytes) const;
+    // Throws if waiting ms would run past the deadline
+    void checkWait(double ms) const;
+private:
+    using Clock = std::chrono::steady_clock;
+    Limits limits_;
+    std::atomic<uint64_t> fuelLeft{0};
+    Clock::time_point deadline;
+    std::atomic<int64_t> used{0};
+};
+
+// The meter of the interpreter running on this thread, if it has limits
+const std::shared_ptr<Meter>& active();
+// Throws if an allocation of bytes would not fit under the active meter's cap
+void checkRoom(size_t bytes);
+
+// Makes meter the active one on this thread until the scope ends
+class Scope {
+public:
+    explicit Scope(const std::shared_ptr<Meter>& meter);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    std::shared_ptr<Meter> previous;
+};
+
+// Bytes held by one container, counted against the meter that was active when it was
+// made. A copy is a new container and is charged again.
+class Charge {
+public:
+    explicit Charge(size_t bytes = 0) : meter(active()) { set(bytes); }
+    Charge(const Charge& other) : Charge(other.bytes_) {}
+    Charge& operator=(const Charge&) = delete;
+    ~Charge() {
+        if (meter) meter->charge(-static_cast<std::ptrdiff_t>(bytes_));
+    }
+    size_t bytes() const { return bytes_; }
+    void set(size_t bytes) {
+        if (!meter || bytes == bytes_) return;
+        meter->charge(static_cast<std::ptrdiff_t>(bytes) - static_cast<std::ptrdiff_t>(bytes_));
+        bytes_ = bytes;
+    }
+private:
+    std::shared_ptr<Meter> meter;
+    size_t bytes_ = 0;
+};
+
+} // namespace budget
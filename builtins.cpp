@@ -0,0 +1,321 @@
+#include "interpreter.h"
+#include "mapped_file.h"
+#include "pack_file.h"
+#include "readers.h"
+#include "scheduler.h"
+#include "sequences.h"
+#include "simd.h"
+#include "sort.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Built-in functions. Returns false when no builtin with this name exists.
+bool Interpreter::callBuiltin(const CallNode* call, Value& result) {
+    const std::string& name = call->func;
+    // sort_inplace(p) sorts the variable itself; evaluating it would hand over a copy
+    if (name == "sort_inplace") {
+        auto id = call->args.size() == 1 ? dynamic_cast<const IdentifierNode*>(call->args[0].get()) : nullptr;
+        if (!id) throw std::runtime_error("sort_inplace() expects a pack variable");
+        bool shared = false;
+        Value* target = findWriteTarget(id->name, shared);
+        if (!target) throw std::runtime_error("Undefined variable: " + id->name);
+        if (shared) throw std::runtime_error("parfor: cannot sort shared pack " + id->name + " in place");
+        sortInPlace(*target);
+        result = 0.0;
+        return true;
+    }
+    std::vector<Value> args;
+    for (const auto& arg : call->args) args.push_back(eval(arg.get()));
+
+    if (name == "len") {
+        if (args.size() != 1) throw std::runtime_error("len() takes one argument");
+        if (std::holds_alternative<Matrix>(args[0])) {
+            result = static_cast<double>(std::get<Matrix>(args[0]).rows);
+            return true;
+        }
+        if (isText(args[0])) {
+            result = static_cast<double>(textOf(args[0]).size());
+            return true;
+        }
+        if (std::holds_alternative<Map>(args[0])) {
+            result = static_cast<double>(std::get<Map>(args[0]).size());
+            return true;
+        }
+        if (!isPack(args[0])) throw std::runtime_error("len() expects array");
+        result = static_cast<double>(packSize(args[0]));
+        return true;
+    }
+    if (name == "sum" || name == "mean") {
+        if (args.size() != 1) throw std::runtime_error(name + "() takes one argument");
+        std::vector<double> scratch;
+        size_t n = 0;
+        const double* data = numericData(args[0], scratch, n);
+        double total = simd::sum(data, n);
+        if (name == "mean") {
+            if (n == 0) throw std::runtime_error("mean() of empty pack");
+            total /= static_cast<double>(n);
+        }
+        result = total;
+        return true;
+    }
+    if (name == "min" || name == "max") {
+        bool isMin = name == "min";
+        // min(a, b) on two numbers, min(pack) as a reduction
+        if (args.size() == 2 && std::holds_alternative<double>(args[0]) && std::holds_alternative<double>(args[1])) {
+            double a = std::get<double>(args[0]), b = std::get<double>(args[1]);
+            result = isMin ? simd::min(a, b) : simd::max(a, b);
+            return true;
+        }
+        if (args.size() != 1) throw std::runtime_error(name + "() takes a pack or two numbers");
+        std::vector<double> scratch;
+        size_t n = 0;
+        const double* data = numericData(args[0], scratch, n);
+        if (n == 0) throw std::runtime_error(name + "() of empty pack");
+        result = isMin ? simd::min(data, n) : simd::max(data, n);
+        return true;
+    }
+    if (name == "dot") {
+        if (args.size() != 2) throw std::runtime_error("dot() takes two arguments");
+        std::vector<double> aScratch, bScratch;
+        size_t an = 0, bn = 0;
+        const double* a = numericData(args[0], aScratch, an);
+        const double* b = numericData(args[1], bScratch, bn);
+        if (an != bn) throw std::runtime_error("dot() expects packs of equal length");
+        result = simd::dot(a, b, an);
+        return true;
+    }
+    if (name == "matrix") {
+        // matrix(rows, cols) is zero-filled, matrix([[..], ..]) copies nested packs,
+        // matrix(rows, cols, pack) reshapes a flat pack
+        if (args.size() == 1) {
+            result = matrixFromRows(args[0]);
+            return true;
+        }
+        if (args.size() < 2 || args.size() > 3 || !std::holds_alternative<double>(args[0]) || !std::holds_alternative<double>(args[1])) {
+            throw std::runtime_error("matrix() takes (rows), (rows, cols) or (rows, cols, pack)");
+        }
+        double rows = std::get<double>(args[0]), cols = std::get<double>(args[1]);
+        if (rows < 0 || cols < 0) throw std::runtime_error("matrix() dimensions must be non-negative");
+        Matrix m = makeMatrix(static_cast<size_t>(rows), static_cast<size_t>(cols));
+        if (args.size() == 3) {
+            std::vector<double> scratch;
+            size_t n = 0;
+            const double* data = numericData(args[2], scratch, n);
+            if (n != m.rows * m.cols) throw std::runtime_error("matrix() pack length does not match rows * cols");
+            std::copy(data, data + n, m.data->begin());
+        }
+        result = m;
+        return true;
+    }
+    if (name == "rows" || name == "cols") {
+        if (args.size() != 1 || !std::holds_alternative<Matrix>(args[0])) throw std::runtime_error(name + "() expects a matrix");
+        const auto& m = std::get<Matrix>(args[0]);
+        result = static_cast<double>(name == "rows" ? m.rows : m.cols);
+        return true;
+    }
+    if (name == "transpose") {
+        if (args.size() != 1 || !std::holds_alternative<Matrix>(args[0])) throw std::runtime_error("transpose() expects a matrix");
+        result = transpose(std::get<Matrix>(args[0]));
+        return true;
+    }
+    if (name == "matmul") {
+        if (args.size() != 2 || !std::holds_alternative<Matrix>(args[0]) || !std::holds_alternative<Matrix>(args[1])) {
+            throw std::runtime_error("matmul() expects two matrices");
+        }
+        const auto& a = std::get<Matrix>(args[0]);
+        const auto& b = std::get<Matrix>(args[1]);
+        if (a.cols != b.rows) throw std::runtime_error("matmul() inner dimensions do not match");
+        result = matmul(a, b);
+        return true;
+    }
+    if (name == "read" || name == "lines") {
+        if (args.size() != 1 || !isText(args[0])) throw std::runtime_error(name + "() expects a file path");
+        auto file = MappedFile::open(std::string(textOf(args[0])));
+        if (name == "lines") result = linesOf(file);
+        else result = TextView{file, file->data(), file->size()};
+        return true;
+    }
+    if (name == "read_csv" || name == "read_json" || name == "json_lines") {
+        if (args.size() != 1 || !isText(args[0])) throw std::runtime_error(name + "() expects a file path");
+        auto file = MappedFile::open(std::string(textOf(args[0])));
+        if (name == "read_csv") result = readCsv(file);
+        else if (name == "read_json") result = parseJson(std::string_view(file->data(), file->size()), file);
+        else result = jsonLines(file);
+        return true;
+    }
+    if (name == "csv_chunks") {
+        if (args.size() != 2 || !isText(args[0]) || !std::holds_alternative<double>(args[1])) {
+            throw std::runtime_error("csv_chunks() expects a file path and a row count");
+        }
+        double rows = std::get<double>(args[1]);
+        if (rows < 1) throw std::runtime_error("csv_chunks: rows must be positive");
+        result = csvChunks(MappedFile::open(std::string(textOf(args[0]))), static_cast<size_t>(rows));
+        return true;
+    }
+    if (name == "parse_json") {
+        if (args.size() != 1 || !isText(args[0])) throw std::runtime_error("parse_json() expects text");
+        // A view keeps its file alive for strings that point into it
+        if (std::holds_alternative<TextView>(args[0])) {
+            const auto& view = std::get<TextView>(args[0]);
+            result = parseJson(view.view(), view.file);
+        } else {
+            result = parseJson(textOf(args[0]));
+        }
+        return true;
+    }
+    if (name == "open_pack") {
+        if (args.empty() || args.size() > 2 || !isText(args[0])) throw std::runtime_error("open_pack() expects a file path");
+        bool copyOnWrite = false;
+        if (args.size() == 2) {
+            std::string_view mode = isText(args[1]) ? textOf(args[1]) : std::string_view();
+            if (mode != "r" && mode != "cow") throw std::runtime_error("open_pack: mode must be \"r\" or \"cow\"");
+            copyOnWrite = mode == "cow";
+        }
+        result = openPack(std::string(textOf(args[0])), copyOnWrite);
+        return true;
+    }
+    if (name == "save_pack") {
+        if (args.size() != 2 || !isText(args[1])) throw std::runtime_error("save_pack() expects a pack and a file path");
+        std::vector<double> scratch;
+        size_t n = 0;
+        const double* data = numericData(args[0], scratch, n);
+        savePack(data, n, std::string(textOf(args[1])));
+        result = static_cast<double>(n);
+        return true;
+    }
+    if (name == "range") {
+        if (args.empty() || args.size() > 3) throw std::runtime_error("range() takes an end, or a start, an end and a step");
+        for (const auto& arg : args) {
+            if (!std::holds_alternative<double>(arg)) throw std::runtime_error("range() expects numbers");
+        }
+        double start = args.size() > 1 ? std::get<double>(args[0]) : 0.0;
+        double end = std::get<double>(args[args.size() > 1 ? 1 : 0]);
+        double step = args.size() > 2 ? std::get<double>(args[2]) : 1.0;
+        result = rangeOf(start, end, step);
+        return true;
+    }
+    if (name == "map" || name == "filter") {
+        if (args.size() != 2 || !std::holds_alternative<FunctionRef>(args[1])) {
+            throw std::runtime_error(name + "() expects a pack or sequence and a function");
+        }
+        auto source = asSequence(args[0], name.c_str());
+        const auto& func = std::get<FunctionRef>(args[1]);
+        result = name == "map" ? mapOf(std::move(source), func) : filterOf(std::move(source), func);
+        return true;
+    }
+    if (name == "take") {
+        if (args.size() != 2 || !std::holds_alternative<double>(args[1]) || std::get<double>(args[1]) < 0) {
+            throw std::runtime_error("take() expects a pack or sequence and a count");
+        }
+        result = takeOf(asSequence(args[0], "take"), static_cast<size_t>(std::get<double>(args[1])));
+        return true;
+    }
+    if (name == "reduce") {
+        if (args.size() != 3 || !std::holds_alternative<FunctionRef>(args[1])) {
+            throw std::runtime_error("reduce() expects a pack or sequence, a function and an initial value");
+        }
+        const FunctionNode* func = std::get<FunctionRef>(args[1]).func;
+        Value acc = args[2];
+        asSequence(args[0], "reduce")->forEach(*this, [&](Value v) {
+            acc = callFunction(func, {std::move(acc), std::move(v)});
+            return true;
+        });
+        result = std::move(acc);
+        return true;
+    }
+    if (name == "collect") {
+        if (args.size() != 1) throw std::runtime_error("collect() takes one argument");
+        // Numbers are gathered contiguously until the first element that is not one
+        std::vector<double> numbers;
+        Pack values;
+        bool numeric = true;
+        asSequence(args[0], "collect")->forEach(*this, [&](Value v) {
+            tick();
+            if (numeric && std::holds_alternative<double>(v)) {
+                // Charged once it becomes a pack; until then only checked as it grows
+                if (numbers.size() == numbers.capacity()) budget::checkRoom(2 * numbers.capacity() * sizeof(double));
+                numbers.push_back(std::get<double>(v));
+                return true;
+            }
+            if (numeric) {
+                numeric = false;
+                for (double x : numbers) values.push_back(std::make_shared<Value>(x));
+            }
+            values.push_back(std::make_shared<Value>(std::move(v)));
+            return true;
+        });
+        if (numeric) result = makeNumPack(std::move(numbers));
+        else result = std::move(values);
+        return true;
+    }
+    if (name == "sort") {
+        if (args.size() != 1 || !isPack(args[0])) throw std::runtime_error("sort() expects a pack");
+        result = sortedPack(args[0]);
+        return true;
+    }
+    if (name == "sort_by") {
+        if (args.size() != 2 || !isPack(args[0]) || !std::holds_alternative<FunctionRef>(args[1])) {
+            throw std::runtime_error("sort_by() expects a pack and a key function");
+        }
+        // Each key is computed once, in order; only the sort itself runs in parallel
+        const FunctionNode* func = std::get<FunctionRef>(args[1]).func;
+        size_t n = packSize(args[0]);
+        std::vector<Value> keys;
+        keys.reserve(n);
+        for (size_t i = 0; i < n; ++i) keys.push_back(callFunction(func, {packAt(args[0], i)}));
+        result = sortedByKeys(args[0], keys);
+        return true;
+    }
+    if (name == "clock") {
+        if (!args.empty()) throw std::runtime_error("clock() takes no arguments");
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        result = std::chrono::duration<double, std::milli>(now).count();
+        return true;
+    }
+    if (name == "random") {
+        static thread_local std::mt19937_64 engine{std::random_device{}()};
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        if (args.empty()) {
+            result = uniform(engine);
+            return true;
+        }
+        if (args.size() != 1 || !std::holds_alternative<double>(args[0]) || std::get<double>(args[0]) < 0) {
+            throw std::runtime_error("random() takes an optional count");
+        }
+        budget::checkRoom(static_cast<size_t>(std::get<double>(args[0])) * sizeof(double));
+        std::vector<double> values(static_cast<size_t>(std::get<double>(args[0])));
+        for (double& x : values) x = uniform(engine);
+        result = makeNumPack(std::move(values));
+        return true;
+    }
+    if (name == "keys") {
+        if (args.size() != 1 || !std::holds_alternative<Map>(args[0])) throw std::runtime_error("keys() expects a map");
+        Pack names;
+        for (const auto& entry : std::get<Map>(args[0]).data->entries) names.push_back(std::make_shared<Value>(entry.first));
+        result = std::move(names);
+        return true;
+    }
+    return false;
+}
+
+// sleep() and run() suspend the calling task, whose stack frames are saved while it
+// waits; they live apart from callBuiltin so its large frame is not among them
+bool Interpreter::callWaitingBuiltin(const CallNode* call, Value& result) {
+    const std::string& name = call->func;
+    if (name != "sleep" && name != "run") return false;
+    std::vector<Value> args;
+    for (const auto& arg : call->args) args.push_back(eval(arg.get()));
+    if (name == "sleep") {
+        if (args.size() != 1 || !std::holds_alternative<double>(args[0])) throw std::runtime_error("sleep() expects milliseconds");
+        if (meter) meter->checkWait(std::get<double>(args[0]));
+        tasks().sleep(std::get<double>(args[0]));
+        result = 0.0;
+        return true;
+    }
+    if (args.size() != 1 || !std::holds_alternative<std::string>(args[0])) throw std::runtime_error("run() expects a command string");
+    result = tasks().runCommand(std::get<std::string>(args[0]));
+    return true;
+}
@@ -1,10 +1,63 @@
 #include "interpreter.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <memory>
 
-Interpreter::Interpreter() {}
+Interpreter::Interpreter(std::shared_ptr<const Program> program, std::ostream& out)
+    : program(std::move(program)), out(out) {}
+Interpreter::~Interpreter() = default;
+
+// Reads container[index] for packs, matrices (a matrix row comes back as a numeric pack)
+// and maps, which take a text key
+static Value indexValue(const Value& container, const Value& index) {
+    if (std::holds_alternative<Map>(container)) {
+        if (!isText(index)) throw std::runtime_error("Map key must be text");
+        const Value* found = std::get<Map>(container).find(textOf(index));
+        if (!found) throw std::runtime_error("Map has no key \"" + std::string(textOf(index)) + "\"");
+        return *found;
+    }
+    if (!std::holds_alternative<double>(index)) throw std::runtime_error("Index must be a number");
+    int i = static_cast<int>(std::get<double>(index));
+    if (std::holds_alternative<Matrix>(container)) {
+        const auto& m = std::get<Matrix>(container);
+        if (i < 0 || i >= (int)m.rows) throw std::runtime_error("Matrix row out of bounds");
+        const double* row = m.values() + static_cast<size_t>(i) * m.cols;
+        return makeNumPack(std::vector<double>(row, row + m.cols));
+    }
+    if (!isPack(container)) throw std::runtime_error("Indexing non-array");
+    if (i < 0 || i >= (int)packSize(container)) throw std::runtime_error("Array index out of bounds");
+    return packAt(container, i);
+}
+
+// Maps + - * / to the vectorized kernel operation
+static bool elementwiseOp(const std::string& op, simd::Op& out) {
+    if (op == "+") out = simd::Op::Add;
+    else if (op == "-") out = simd::Op::Sub;
+    else if (op == "*") out = simd::Op::Mul;
+    else if (op == "/") out = simd::Op::Div;
+    else return false;
+    return true;
+}
+
+// Case lookup for exec; a value outside the jump table, or not an integer, matches nothing
+int SwitchNode::find(double v) const {
+    if (!table.empty()) {
+        double slot = v - tableBase;
+        if (!(slot >= 0 && slot < static_cast<double>(table.size())) || v != std::floor(v)) return -1;
+        return table[static_cast<size_t>(slot)];
+    }
+    auto it = numberCases.find(v);
+    return it == numberCases.end() ? -1 : it->second;
+}
+
+int SwitchNode::find(const std::string& v) const {
+    auto it = textCases.find(v);
+    return it == textCases.end() ? -1 : it->second;
+}
 
 void Interpreter::pushScope() {
     callStack.push_back(variables);
@@ -16,29 +69,117 @@ void Interpreter::popScope() {
 void Interpreter::setVar(const std::string& name, const Value& value) {
     variables[name] = value;
 }
-Interpreter::Value Interpreter::getVar(const std::string& name) {
+Value* Interpreter::findWriteTarget(const std::string& name, bool& shared) {
+    auto target = sharedTargets.find(name);
+    shared = target != sharedTargets.end();
+    if (shared) return target->second;
     auto it = variables.find(name);
-    if (it == variables.end()) throw std::runtime_error("Undefined variable: " + name);
-    return it->second;
+    if (it != variables.end()) return &it->second;
+    // An inherited variable is copied in before its first write
+    const Value* below = inherited ? lookup(name) : nullptr;
+    return below ? &(variables[name] = *below) : nullptr;
 }
-
-void Interpreter::interpret(const std::vector<std::unique_ptr<ASTNode>>& ast) {
-    // Register all functions first
-    for (const auto& node : ast) {
-        if (auto func = dynamic_cast<const FunctionNode*>(node.get())) {
-            functions[func->name] = func;
+const Value* Interpreter::lookup(const std::string& name) const {
+    auto it = variables.find(name);
+    if (it != variables.end()) return &it->second;
+    if (!inherited) return nullptr;
+    auto below = inherited->find(name);
+    return below == inherited->end() ? nullptr : &below->second;
+}
+Scheduler& Interpreter::tasks() {
+    if (!scheduler) scheduler = std::make_unique<Scheduler>(*this);
+    return *scheduler;
+}
+void Interpreter::drainTasks() {
+    if (scheduler) scheduler->drain();
+}
+Value Interpreter::callFunction(const FunctionNode* func, const std::vector<Value>& args) {
+    if (args.size() != func->params.size()) throw std::runtime_error("Argument count mismatch in call to " + func->name);
+    tick();
+    if ((maxCallDepth && callDepth >= maxCallDepth) || budget::stackLow()) throw budget::tooDeep(callDepth, maxCallDepth);
+    // Closes the profiler frame however the call ends
+    struct ProfileScope {
+        profiler::Stack* stack;
+        ~ProfileScope() {
+            if (stack) profiler::leave(*stack);
+        }
+    } profiled{profiler::on() ? &profileStack : nullptr};
+    if (profiled.stack) profiler::enter(profileStack, func);
+    // Gives the caller back its variables, shared containers and depth however the call
+    // ends, so a Context stays usable after a call that threw. Inside a parfor body only
+    // the body itself writes into shared containers; a callee works on its own copies,
+    // as it would in a serial loop.
+    struct CallScope {
+        Interpreter& interp;
+        std::unordered_map<std::string, Value*> callerTargets;
+        explicit CallScope(Interpreter& interp) : interp(interp) {
+            interp.pushScope();
+            callerTargets.swap(interp.sharedTargets);
+            ++interp.callDepth;
         }
+        ~CallScope() {
+            interp.popScope();
+            interp.sharedTargets.swap(callerTargets);
+            interp.hasReturn = false;
+            --interp.callDepth;
+        }
+    } scope(*this);
+    for (size_t i = 0; i < func->params.size(); ++i) {
+        setVar(func->params[i], args[i]);
+    }
+    hasReturn = false;
+    for (const auto& stmt : func->body) {
+        exec(stmt.get());
+        if (hasReturn) break;
     }
-    // Execute all top-level statements (skip function definitions)
-    for (const auto& node : ast) {
+    return hasReturn ? returnValue : 0.0;
+}
+Value Interpreter::getVar(const std::string& name) {
+    const Value* value = lookup(name);
+    if (!value) throw std::runtime_error("Undefined variable: " + name);
+    return *value;
+}
+
+void Interpreter::setLimits(const budget::Limits& limits) {
+    meter = limits.any() ? std::make_shared<budget::Meter>(limits) : nullptr;
+    maxCallDepth = limits.callDepth;
+}
+
+void Interpreter::startBudget() {
+    if (meter) meter->restart();
+    ticksLeft = 1;
+}
+
+void Interpreter::refuel() {
+    ticksLeft = meter ? meter->draw(budget::CHECK_INTERVAL) : UINT32_MAX;
+}
+
+void Interpreter::run() {
+    budget::Scope scope(meter);
+    startBudget();
+    hasReturn = false;
+    // Execute all top-level statements (functions were registered by the Program)
+    for (const auto& node : program->ast) {
         if (!dynamic_cast<const FunctionNode*>(node.get())) {
             exec(node.get());
             if (hasReturn) break;
         }
     }
+    drainTasks();
+}
+
+Value Interpreter::call(const std::string& name, const std::vector<Value>& args) {
+    const FunctionNode* func = program->findFunction(name);
+    if (!func) throw std::runtime_error("Unknown function: " + name);
+    budget::Scope scope(meter);
+    startBudget();
+    Value result = callFunction(func, args);
+    drainTasks();
+    return result;
 }
 
 void Interpreter::exec(const ASTNode* node) {
+    if (profiler::on()) profiler::statement(profileStack, node);
     if (auto var = dynamic_cast<const VarDeclNode*>(node)) {
         if (variables.count(var->name)) {
             variables[var->name] = eval(var->value.get());
@@ -47,31 +188,19 @@ void Interpreter::exec(const ASTNode* node) {
         }
     } else if (auto print = dynamic_cast<const PrintNode*>(node)) {
         auto value = eval(print->expr.get());
-        if (std::holds_alternative<double>(value)) {
-            std::cout << std::get<double>(value) << std::endl;
-        } else if (std::holds_alternative<std::string>(value)) {
-            std::cout << std::get<std::string>(value) << std::endl;
-        }
+        printValue(out, value);
+        out << std::endl;
     } else if (auto ifNode = dynamic_cast<const IfNode*>(node)) {
-        auto cond = eval(ifNode->condition.get());
-        bool condTrue = false;
-        if (std::holds_alternative<double>(cond)) {
-            condTrue = std::get<double>(cond) != 0.0;
-        } else if (std::holds_alternative<std::string>(cond)) {
-            condTrue = !std::get<std::string>(cond).empty();
-        }
-        if (condTrue) {
-            for (const auto& stmt : ifNode->thenBranch) exec(stmt.get());
-        } else {
-            for (const auto& stmt : ifNode->elseBranch) exec(stmt.get());
+        bool condTrue = isTrue(eval(ifNode->condition.get()));
+        const auto& branch = condTrue ? ifNode->thenBranch : ifNode->elseBranch;
+        for (const auto& stmt : branch) {
+            exec(stmt.get());
+            if (hasReturn) return;
         }
     } else if (auto whileNode = dynamic_cast<const WhileNode*>(node)) {
         while (true) {
-            auto cond = eval(whileNode->condition.get());
-            bool condTrue = false;
-            if (std::holds_alternative<double>(cond)) condTrue = std::get<double>(cond) != 0.0;
-            if (std::holds_alternative<std::string>(cond)) condTrue = !std::get<std::string>(cond).empty();
-            if (!condTrue) break;
+            if (!isTrue(eval(whileNode->condition.get()))) break;
+            tick();
             for (const auto& stmt : whileNode->body) exec(stmt.get());
             if (hasReturn) return;
         }
@@ -80,24 +209,39 @@ void Interpreter::exec(const ASTNode* node) {
         double start = std::get<double>(eval(forNode->condition.get()));
         double end = 0;
         double step = 1;
-        if (auto bin = dynamic_cast<const BinaryExprNode*>(forNode->increment.get())) {
-            if (bin->op == "step") {
-                end = std::get<double>(eval(bin->left.get()));
-                step = std::get<double>(eval(bin->right.get()));
-            }
+        auto bin = dynamic_cast<const BinaryExprNode*>(forNode->increment.get());
+        if (bin && bin->op == "step") {
+            end = std::get<double>(eval(bin->left.get()));
+            step = std::get<double>(eval(bin->right.get()));
         } else {
-            end = std::get<double>(eval(forNode->increment.get()));
+            end = std::get<double>(eval(static_cast<const ExprNode*>(forNode->increment.get())));
         }
+        if (forNode->parallel && execParallelFor(forNode, varName, start, end, step)) return;
         for (double i = start; (step > 0 ? i <= end : i >= end); i += step) {
             variables[varName] = i;
+            tick();
             for (const auto& stmt : forNode->body) exec(stmt.get());
             if (hasReturn) return;
         }
-    } else if (auto func = dynamic_cast<const FunctionNode*>(node)) {
+    } else if (auto forIn = dynamic_cast<const ForInNode*>(node)) {
+        execForIn(forIn);
+    } else if (auto sw = dynamic_cast<const SwitchNode*>(node)) {
+        // Values other than numbers and text match no label
+        Value v = eval(sw->expr.get());
+        int index = -1;
+        if (std::holds_alternative<double>(v)) index = sw->find(std::get<double>(v));
+        else if (std::holds_alternative<std::string>(v)) index = sw->find(std::get<std::string>(v));
+        else if (std::holds_alternative<TextView>(v)) index = sw->find(std::string(textOf(v)));
+        for (const auto& stmt : index < 0 ? sw->defaultBody : sw->cases[index].body) {
+            exec(stmt.get());
+            if (hasReturn) return;
+        }
+    } else if (dynamic_cast<const FunctionNode*>(node)) {
         // Already registered
     } else if (auto ret = dynamic_cast<const ReturnNode*>(node)) {
-        hasReturn = true;
+        // Evaluate first: a call in the return expression resets hasReturn when it returns
         returnValue = eval(ret->value.get());
+        hasReturn = true;
     } else if (auto var = dynamic_cast<const VarDeclNode*>(node)) {
         variables[var->name] = eval(var->value.get());
     } else {
@@ -105,79 +249,213 @@ void Interpreter::exec(const ASTNode* node) {
     }
 }
 
-Interpreter::Value Interpreter::eval(const ExprNode* expr) {
+void Interpreter::execForIn(const ForInNode* forIn) {
+    auto iterable = eval(forIn->iterable.get());
+    // Runs the body for one element; false once a return has been hit
+    auto step = [&](Value element) {
+        variables[forIn->var] = std::move(element);
+        tick();
+        for (const auto& stmt : forIn->body) {
+            exec(stmt.get());
+            if (hasReturn) return false;
+        }
+        return true;
+    };
+    if (std::holds_alternative<SequencePtr>(iterable)) {
+        std::get<SequencePtr>(iterable)->forEach(*this, step);
+    } else if (std::holds_alternative<Map>(iterable)) {
+        // Keys are copied first so the body may write to the map
+        std::vector<std::string> keys;
+        for (const auto& entry : std::get<Map>(iterable).data->entries) keys.push_back(entry.first);
+        for (auto& key : keys) {
+            if (!step(std::move(key))) return;
+        }
+    } else if (isPack(iterable)) {
+        size_t n = packSize(iterable);
+        for (size_t i = 0; i < n; ++i) {
+            if (!step(packAt(iterable, i))) return;
+        }
+    } else if (std::holds_alternative<Matrix>(iterable)) {
+        const auto& m = std::get<Matrix>(iterable);
+        for (size_t r = 0; r < m.rows; ++r) {
+            const double* row = m.values() + r * m.cols;
+            if (!step(makeNumPack(std::vector<double>(row, row + m.cols)))) return;
+        }
+    } else {
+        throw std::runtime_error("for-in expects a pack, a matrix, a map or a sequence");
+    }
+}
+
+Value Interpreter::eval(const ExprNode* expr) {
     if (auto call = dynamic_cast<const CallNode*>(expr)) {
         // User-defined function call
-        auto it = functions.find(call->func);
-        if (it != functions.end()) {
-            const FunctionNode* func = it->second;
-            if (call->args.size() != func->params.size()) throw std::runtime_error("Argument count mismatch in call to " + func->name);
-            pushScope();
-            for (size_t i = 0; i < func->params.size(); ++i) {
-                setVar(func->params[i], eval(call->args[i].get()));
-            }
-            hasReturn = false;
-            for (const auto& stmt : func->body) {
-                exec(stmt.get());
-                if (hasReturn) break;
-            }
-            Value ret = hasReturn ? returnValue : 0.0;
-            hasReturn = false;
-            popScope();
-            return ret;
-        }
-        // Built-in functions (len already handled above)
-        if (call->func == "len") {
-            if (call->args.size() != 1) throw std::runtime_error("len() takes one argument");
-            auto arrVal = eval(call->args[0].get());
-            if (!std::holds_alternative<std::vector<std::shared_ptr<Value>>>(arrVal)) throw std::runtime_error("len() expects array");
-            return static_cast<double>(std::get<std::vector<std::shared_ptr<Value>>>(arrVal).size());
+        if (const FunctionNode* func = program->findFunction(call->func)) {
+            std::vector<Value> args;
+            for (const auto& arg : call->args) args.push_back(eval(arg.get()));
+            return callFunction(func, args);
+        }
+        // A variable holding a function reference is called like the function
+        const Value* ref = lookup(call->func);
+        if (ref && std::holds_alternative<FunctionRef>(*ref)) {
+            const FunctionNode* func = std::get<FunctionRef>(*ref).func;
+            std::vector<Value> args;
+            for (const auto& arg : call->args) args.push_back(eval(arg.get()));
+            return callFunction(func, args);
         }
+        Value result;
+        if (callWaitingBuiltin(call, result) || callBuiltin(call, result)) return result;
         throw std::runtime_error("Unknown function: " + call->func);
+    } else if (auto spawn = dynamic_cast<const SpawnNode*>(expr)) {
+        const FunctionNode* func = program->findFunction(spawn->call->func);
+        if (!func) throw std::runtime_error("spawn: unknown function " + spawn->call->func);
+        std::vector<Value> args;
+        for (const auto& arg : spawn->call->args) args.push_back(eval(arg.get()));
+        if (args.size() != func->params.size()) throw std::runtime_error("Argument count mismatch in call to " + func->name);
+        return tasks().spawn(func, std::move(args));
+    } else if (auto await = dynamic_cast<const AwaitNode*>(expr)) {
+        auto task = eval(await->task.get());
+        if (!std::holds_alternative<std::shared_ptr<Task>>(task)) throw std::runtime_error("await expects a task");
+        return tasks().await(std::get<std::shared_ptr<Task>>(task));
     } else if (auto num = dynamic_cast<const NumberNode*>(expr)) {
         return std::stod(num->value);
     } else if (auto str = dynamic_cast<const StringNode*>(expr)) {
         return str->value;
     } else if (auto id = dynamic_cast<const IdentifierNode*>(expr)) {
-        auto it = variables.find(id->name);
-        if (it == variables.end()) throw std::runtime_error("Undefined variable: " + id->name);
-        return it->second;
+        if (const Value* value = lookup(id->name)) return *value;
+        // A function's name on its own is a reference to it
+        if (const FunctionNode* func = program->findFunction(id->name)) return FunctionRef{func, program};
+        throw std::runtime_error("Undefined variable: " + id->name);
+    } else if (auto slice = dynamic_cast<const SliceNode*>(expr)) {
+        auto container = eval(slice->array.get());
+        // Bounds are clamped to the container; negative ones count back from its end
+        auto bound = [&](const ExprNode* node, size_t missing) {
+            if (!node) return missing;
+            auto v = eval(node);
+            if (!std::holds_alternative<double>(v)) throw std::runtime_error("Slice bounds must be numbers");
+            double b = std::get<double>(v);
+            size_t n = isPack(container) ? packSize(container) : isText(container) ? textOf(container).size() : 0;
+            if (b < 0) b = std::max(0.0, static_cast<double>(n) + b);
+            return static_cast<size_t>(std::min(b, static_cast<double>(n)));
+        };
+        size_t begin = bound(slice->start.get(), 0);
+        size_t end = bound(slice->end.get(), static_cast<size_t>(-1));
+        return sliceValue(container, begin, end);
     } else if (auto arr = dynamic_cast<const ArrayNode*>(expr)) {
-        std::vector<std::shared_ptr<Value>> elements;
+        std::vector<Value> values;
+        bool numeric = true;
         for (const auto& el : arr->elements) {
-            elements.push_back(std::make_shared<Value>(eval(el.get())));
+            values.push_back(eval(el.get()));
+            numeric = numeric && std::holds_alternative<double>(values.back());
+        }
+        // All-number literals get contiguous storage so the SIMD kernels can run on them
+        if (numeric) {
+            std::vector<double> nums;
+            nums.reserve(values.size());
+            for (const auto& v : values) nums.push_back(std::get<double>(v));
+            return makeNumPack(std::move(nums));
+        }
+        Pack elements;
+        for (auto& v : values) {
+            elements.push_back(std::make_shared<Value>(std::move(v)));
         }
         return elements;
     } else if (auto idx = dynamic_cast<const IndexNode*>(expr)) {
-        auto arrVal = eval(idx->array.get());
-        auto idxVal = eval(idx->index.get());
-        if (!std::holds_alternative<std::vector<std::shared_ptr<Value>>>(arrVal)) throw std::runtime_error("Indexing non-array");
-        auto& vec = std::get<std::vector<std::shared_ptr<Value>>>(arrVal);
-        int i = static_cast<int>(std::get<double>(idxVal));
-        if (i < 0 || i >= (int)vec.size()) throw std::runtime_error("Array index out of bounds");
-        return *vec[i];
+        // m[i][j] on a matrix reads the element directly instead of materializing row i
+        if (auto inner = dynamic_cast<const IndexNode*>(idx->array.get())) {
+            auto base = eval(inner->array.get());
+            auto rowVal = eval(inner->index.get());
+            auto colVal = eval(idx->index.get());
+            if (std::holds_alternative<Matrix>(base) && std::holds_alternative<double>(rowVal) && std::holds_alternative<double>(colVal)) {
+                const auto& m = std::get<Matrix>(base);
+                int r = static_cast<int>(std::get<double>(rowVal));
+                int c = static_cast<int>(std::get<double>(colVal));
+                if (r < 0 || r >= (int)m.rows || c < 0 || c >= (int)m.cols) throw std::runtime_error("Matrix index out of bounds");
+                return m.at(r, c);
+            }
+            return indexValue(indexValue(base, rowVal), colVal);
+        }
+        return indexValue(eval(idx->array.get()), eval(idx->index.get()));
     } else if (auto bin = dynamic_cast<const BinaryExprNode*>(expr)) {
         if (bin->op == "[]=") {
             // Array assignment: left is IndexNode, right is value
             auto idxNode = dynamic_cast<const IndexNode*>(bin->left.get());
             if (!idxNode) throw std::runtime_error("Invalid array assignment");
+            // Matrix element assignment: m[i][j] = value
+            if (auto rowNode = dynamic_cast<const IndexNode*>(idxNode->array.get())) {
+                auto matId = dynamic_cast<const IdentifierNode*>(rowNode->array.get());
+                if (!matId) throw std::runtime_error("Matrix assignment must be to a variable");
+                bool shared = false;
+                Value* target = findWriteTarget(matId->name, shared);
+                if (!target) throw std::runtime_error("Undefined matrix: " + matId->name);
+                if (!std::holds_alternative<Matrix>(*target)) throw std::runtime_error("Nested index assignment requires a matrix");
+                int r = static_cast<int>(std::get<double>(eval(rowNode->index.get())));
+                int c = static_cast<int>(std::get<double>(eval(idxNode->index.get())));
+                auto& m = std::get<Matrix>(*target);
+                if (r < 0 || r >= (int)m.rows || c < 0 || c >= (int)m.cols) throw std::runtime_error("Matrix index out of bounds");
+                auto value = eval(bin->right.get());
+                if (!std::holds_alternative<double>(value)) throw std::runtime_error("Matrix elements must be numbers");
+                auto& data = shared ? *m.data : m.mutableData();
+                data[r * m.cols + c] = std::get<double>(value);
+                return value;
+            }
             auto arrId = dynamic_cast<const IdentifierNode*>(idxNode->array.get());
             if (!arrId) throw std::runtime_error("Array assignment must be to a variable");
-            auto arrIt = variables.find(arrId->name);
-            if (arrIt == variables.end()) throw std::runtime_error("Undefined array: " + arrId->name);
-            if (!std::holds_alternative<std::vector<std::shared_ptr<Value>>>(arrIt->second)) throw std::runtime_error("Variable is not an array");
-            auto& vec = std::get<std::vector<std::shared_ptr<Value>>>(arrIt->second);
+            bool shared = false;
+            Value* target = findWriteTarget(arrId->name, shared);
+            if (!target) throw std::runtime_error("Undefined array: " + arrId->name);
+            if (std::holds_alternative<Map>(*target)) {
+                auto key = eval(idxNode->index.get());
+                if (!isText(key)) throw std::runtime_error("Map key must be text");
+                if (shared) throw std::runtime_error("parfor: cannot write to map " + arrId->name);
+                auto value = eval(bin->right.get());
+                std::get<Map>(*target).set(std::string(textOf(key)), value);
+                return value;
+            }
+            if (!isPack(*target)) throw std::runtime_error("Variable is not an array");
             int i = static_cast<int>(std::get<double>(eval(idxNode->index.get())));
-            if (i < 0 || i >= (int)vec.size()) throw std::runtime_error("Array index out of bounds");
-            vec[i] = std::make_shared<Value>(eval(bin->right.get()));
-            return *vec[i];
+            if (i < 0 || i >= (int)packSize(*target)) throw std::runtime_error("Array index out of bounds");
+            auto value = eval(bin->right.get());
+            if (std::holds_alternative<NumPack>(*target)) {
+                auto& pack = std::get<NumPack>(*target);
+                if (std::holds_alternative<double>(value)) {
+                    // parfor workers write their own disjoint slots of the shared storage
+                    if (shared) pack.data->values[pack.offset + i] = std::get<double>(value);
+                    else pack.mutableData()[i] = std::get<double>(value);
+                    return value;
+                }
+                if (shared) throw std::runtime_error("parfor: cannot store a non-number into numeric pack " + arrId->name);
+                // Storing a non-number demotes the pack to generic storage
+                Pack elements;
+                for (size_t k = 0; k < pack.size(); ++k) elements.push_back(std::make_shared<Value>(pack.values()[k]));
+                *target = std::move(elements);
+            }
+            auto& pack = std::get<Pack>(*target);
+            // parfor workers write their own disjoint slots of the shared storage
+            auto* slot = shared ? pack.data->data() + pack.offset + i : pack.mutableData() + i;
+            *slot = std::make_shared<Value>(value);
+            return value;
         }
         auto left = eval(bin->left.get());
         auto right = eval(bin->right.get());
+        // Text views compare in place; every other operator works on string copies
+        if (std::holds_alternative<TextView>(left) || std::holds_alternative<TextView>(right)) {
+            if ((bin->op == "==" || bin->op == "!=") && isText(left) && isText(right)) {
+                return (textOf(left) == textOf(right)) == (bin->op == "==") ? 1.0 : 0.0;
+            }
+            if (std::holds_alternative<TextView>(left)) left = std::string(textOf(left));
+            if (std::holds_alternative<TextView>(right)) right = std::string(textOf(right));
+        }
+        // Whole-pack and matrix arithmetic runs on the vectorized kernels
+        bool matrixOperand = std::holds_alternative<Matrix>(left) || std::holds_alternative<Matrix>(right);
+        simd::Op op;
+        if ((matrixOperand || isPack(left) || isPack(right)) && elementwiseOp(bin->op, op)) {
+            return matrixOperand ? matrixArith(op, left, right) : packArith(op, left, right);
+        }
         if (bin->op == "+") {
             if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
                 return std::get<double>(left) + std::get<double>(right);
             } else if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
+                budget::checkRoom(std::get<std::string>(left).size() + std::get<std::string>(right).size());
                 return std::get<std::string>(left) + std::get<std::string>(right);
             } else if (std::holds_alternative<std::string>(left) && std::holds_alternative<double>(right)) {
                 return std::get<std::string>(left) + std::to_string(std::get<double>(right));
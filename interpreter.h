@@ -1,27 +1,78 @@
 #pragma once
 #include "ast.h"
+#include "budget.h"
+#include "profiler.h"
+#include "program.h"
+#include "value.h"
+#include <iostream>
 #include <unordered_map>
 #include <string>
-#include <variant>
 #include <vector>
 #include <memory>
 
-using Value = std::variant<double, std::string, std::vector<std::shared_ptr<Value>>>;
+class Scheduler;
 
+// Execution context for a Program: variables, call stack and tasks of one run. Contexts
+// are cheap to create and are used by one thread at a time; share the Program instead.
 class Interpreter {
 public:
-    Interpreter();
-    void interpret(const std::vector<std::unique_ptr<ASTNode>>& ast);
+    explicit Interpreter(std::shared_ptr<const Program> program, std::ostream& out = std::cout);
+    ~Interpreter();
+    // Runs the top-level statements, then any spawned tasks still pending
+    void run();
+    // Calls a function of the program; globals set by run() or setVar() stay visible
+    Value call(const std::string& name, const std::vector<Value>& args);
+    void setVar(const std::string& name, const Value& value);
+    Value getVar(const std::string& name);
+    // Runs func with args bound to its parameters in a fresh scope
+    Value callFunction(const FunctionNode* func, const std::vector<Value>& args);
+    // Applies to every later run() and call(), each of which gets the full fuel and
+    // deadline; exceeding a limit throws BudgetExceeded. Limits{} removes them.
+    void setLimits(const budget::Limits& limits);
 private:
+    std::shared_ptr<const Program> program;
+    std::ostream& out;
     std::unordered_map<std::string, Value> variables;
-    std::unordered_map<std::string, const FunctionNode*> functions;
+    // Read-only variables beneath `variables`: in a task, the main program's variables
+    // when it started, shared by every task started in the same wait. Writes go to
+    // `variables`.
+    std::shared_ptr<const std::unordered_map<std::string, Value>> inherited;
     std::vector<std::unordered_map<std::string, Value>> callStack;
     bool hasReturn = false;
     Value returnValue;
+    // Calls in progress, kept only while profiling
+    profiler::Stack profileStack;
+    // Containers a parfor body writes by slot, pointing at the loop's enclosing variables
+    std::unordered_map<std::string, Value*> sharedTargets;
+    // Created on first spawn/await/sleep/run; swaps the state above between tasks
+    std::unique_ptr<Scheduler> scheduler;
+    // Shared with parfor workers; null without limits
+    std::shared_ptr<budget::Meter> meter;
+    uint32_t ticksLeft = 1;
+    // Calls in progress, and the most allowed at once (0: as many as the stack holds)
+    uint32_t callDepth = 0;
+    uint32_t maxCallDepth = 0;
+    friend class Scheduler;
     void exec(const ASTNode* node);
+    void execForIn(const ForInNode* forIn);
+    // Runs a parfor on the thread pool; false when it has to run as a serial loop instead
+    bool execParallelFor(const ForNode* forNode, const std::string& varName, double start, double end, double step);
+    Value* findWriteTarget(const std::string& name, bool& shared);
+    // The variable's value, looking through to the inherited variables; null if undefined
+    const Value* lookup(const std::string& name) const;
     Value eval(const ExprNode* expr);
+    // Counts a loop iteration or a call against the fuel and deadline
+    void tick() {
+        if (--ticksLeft == 0) refuel();
+    }
+    void refuel();
+    // Restarts the budget for a run() or call() from the host
+    void startBudget();
+    bool callBuiltin(const CallNode* call, Value& result);
+    bool callWaitingBuiltin(const CallNode* call, Value& result);
+    Scheduler& tasks();
+    // Runs spawned tasks nobody awaited to completion
+    void drainTasks();
     void pushScope();
     void popScope();
-    void setVar(const std::string& name, const Value& value);
-    Value getVar(const std::string& name);
 }; 
\ No newline at end of file
@@ -1,12 +1,14 @@
 #include "lexer.h"
+#include "scan.h"
 #include "tokens.h"
+#include <algorithm>
 #include <sstream>
-#include <cctype>
 
-Lexer::Lexer(const std::string& src) : source(src), pos(0), line(1), column(1) {}
+Lexer::Lexer(const std::string& src) : source(src), pos(0) {}
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
+    tokens.reserve(source.size() / 4 + 1);
     Token token;
     do {
         token = nextToken();
@@ -15,147 +17,161 @@ std::vector<Token> Lexer::tokenize() {
     return tokens;
 }
 
-char Lexer::peek() const {
-    if (pos < source.size()) return source[pos];
-    return '\0';
-}
-
-char Lexer::get() {
-    if (pos < source.size()) {
-        char c = source[pos++];
-        if (c == '\n') {
-            line++;
-            column = 1;
-        } else {
-            column++;
-        }
-        return c;
-    }
+char Lexer::peek(size_t ahead) const {
+    if (pos + ahead < source.size()) return source[pos + ahead];
     return '\0';
 }
 
 void Lexer::skipWhitespace() {
-    while (isspace(peek())) get();
+    pos = scan::skipSpace(source.data(), pos, source.size());
 }
 
 Token Lexer::nextToken() {
+    const char* s = source.data();
+    size_t n = source.size();
     skipWhitespace();
-    int startLine = line;
-    int startCol = column;
+    size_t start = pos;
     char c = peek();
-    if (c == '\0') {
-        return {TokenType::EndOfFile, "", startLine, startCol};
+    if (pos >= n) {
+        return {TokenType::EndOfFile, "", start};
     }
     // Header: #use <...>
     if (c == '#') {
-        std::string value;
-        while (c != '\0' && c != '\n') {
-            value += get();
-            c = peek();
-        }
-        return {TokenType::Header, value, startLine, startCol};
+        pos = scan::find(s, pos, n, '\n');
+        return {TokenType::Header, source.substr(start, pos - start), start};
     }
     // Comments
-    if (c == '/' && source[pos + 1] == '/') {
-        while (peek() != '\n' && peek() != '\0') get();
+    if (c == '/' && peek(1) == '/') {
+        pos = scan::find(s, pos, n, '\n');
         return nextToken();
     }
     // Identifiers/Keywords
-    if (isalpha(c) || c == '_') {
-        std::string value;
-        while (isalnum(peek()) || peek() == '_') {
-            value += get();
-        }
+    if (scan::is(c, scan::IdentStart)) {
+        pos = scan::skipIdent(s, pos, n);
+        std::string value = source.substr(start, pos - start);
         if (value == "true" || value == "false") {
-            return {TokenType::Keyword, value, startLine, startCol};
+            return {TokenType::Keyword, value, start};
         }
         if (KEYWORDS.count(value)) {
-            return {TokenType::Keyword, value, startLine, startCol};
+            return {TokenType::Keyword, value, start};
         } else {
-            return {TokenType::Identifier, value, startLine, startCol};
+            return {TokenType::Identifier, value, start};
         }
     }
     // Numbers (int or decimal)
-    if (isdigit(c)) {
-        std::string value;
+    if (scan::is(c, scan::Digit)) {
         bool isDecimal = false;
-        while (isdigit(peek()) || peek() == '.') {
+        while (scan::is(peek(), scan::Digit) || peek() == '.') {
             if (peek() == '.') {
                 if (isDecimal) break; // Only one dot allowed
                 isDecimal = true;
             }
-            value += get();
+            ++pos;
         }
-        return {isDecimal ? TokenType::Decimal : TokenType::Number, value, startLine, startCol};
+        return {isDecimal ? TokenType::Decimal : TokenType::Number, source.substr(start, pos - start), start};
     }
     // Strings
     if (c == '"') {
-        get(); // consume opening quote
+        ++pos; // consume opening quote
         std::string value;
-        while (peek() != '"' && peek() != '\0') {
-            if (peek() == '\\') { // handle escape
-                get();
-                char next = get();
-                value += next;
-            } else {
-                value += get();
-            }
+        while (true) {
+            // Copy everything up to the next quote or escape in one piece
+            size_t stop = scan::findEither(s, pos, n, '"', '\\');
+            value.append(s + pos, stop - pos);
+            pos = stop;
+            if (pos >= n || s[pos] == '"') break;
+            // handle escape: keep the escaped character as is
+            if (pos + 1 < n) value += s[pos + 1];
+            pos = std::min(pos + 2, n);
         }
-        get(); // consume closing quote
-        return {TokenType::String, value, startLine, startCol};
+        if (pos < n) ++pos; // consume closing quote
+        return {TokenType::String, value, start};
     }
     // Operators and symbols
     // Multi-character operators
-    if (c == '=') {
-        get();
-        if (peek() == '=') { get(); return {TokenType::Operator, "==", startLine, startCol}; }
-        return {TokenType::Assign, "=", startLine, startCol};
-    }
-    if (c == '!') {
-        get();
-        if (peek() == '=') { get(); return {TokenType::Operator, "!=", startLine, startCol}; }
-        return {TokenType::Operator, "!", startLine, startCol};
-    }
-    if (c == '<') {
-        get();
-        if (peek() == '=') { get(); return {TokenType::Operator, "<=", startLine, startCol}; }
-        return {TokenType::Operator, "<", startLine, startCol};
-    }
-    if (c == '>') {
-        get();
-        if (peek() == '=') { get(); return {TokenType::Operator, ">=", startLine, startCol}; }
-        return {TokenType::Operator, ">", startLine, startCol};
-    }
-    if (c == '&') {
-        get();
-        if (peek() == '&') { get(); return {TokenType::Operator, "&&", startLine, startCol}; }
-        return {TokenType::Unknown, "&", startLine, startCol};
+    auto two = [&](char next, const char* pair, TokenType pairType, TokenType singleType) -> Token {
+        ++pos;
+        if (peek() == next) {
+            ++pos;
+            return {pairType, pair, start};
+        }
+        return {singleType, std::string(1, c), start};
+    };
+    if (c == '=') return two('=', "==", TokenType::Operator, TokenType::Assign);
+    if (c == '!') return two('=', "!=", TokenType::Operator, TokenType::Operator);
+    if (c == '<') return two('=', "<=", TokenType::Operator, TokenType::Operator);
+    if (c == '>') return two('=', ">=", TokenType::Operator, TokenType::Operator);
+    if (c == '&') return two('&', "&&", TokenType::Operator, TokenType::Unknown);
+    if (c == '|') return two('|', "||", TokenType::Operator, TokenType::Unknown);
+    ++pos;
+    switch (c) {
+        case '+': case '-': case '*': case '/': case ';':
+            return {TokenType::Operator, std::string(1, c), start};
+        case '(': return {TokenType::LParen, "(", start};
+        case ')': return {TokenType::RParen, ")", start};
+        case '[': return {TokenType::LBracket, "[", start};
+        case ']': return {TokenType::RBracket, "]", start};
+        case '{': return {TokenType::LBrace, "{", start};
+        case '}': return {TokenType::RBrace, "}", start};
+        case ',': return {TokenType::Comma, ",", start};
+        case ':': return {TokenType::Colon, ":", start};
     }
-    if (c == '|') {
-        get();
-        if (peek() == '|') { get(); return {TokenType::Operator, "||", startLine, startCol}; }
-        return {TokenType::Unknown, "|", startLine, startCol};
+    // Unknown character
+    return {TokenType::Unknown, std::string(1, c), start};
+}
+
+std::vector<TopLevelFunc> findTopLevelFuncs(const std::string& source) {
+    std::vector<TopLevelFunc> funcs;
+    auto isWord = [](char c) { return scan::is(c, scan::Ident); };
+    size_t n = source.size();
+    int depth = 0;
+    bool open = false; // inside a func found at depth zero
+    for (size_t i = 0; i < n; ++i) {
+        char c = source[i];
+        if (c == '"') {
+            for (++i; i < n && source[i] != '"'; ++i) {
+                if (source[i] == '\\') ++i;
+            }
+        } else if ((c == '/' && i + 1 < n && source[i + 1] == '/') || c == '#') {
+            while (i < n && source[i] != '\n') ++i;
+        } else if (c == '{') {
+            ++depth;
+        } else if (c == '}') {
+            if (depth > 0 && --depth == 0 && open) {
+                funcs.back().end = i + 1;
+                open = false;
+            }
+        } else if (depth == 0 && !open && c == 'f' && source.compare(i, 4, "func") == 0 &&
+                   (i == 0 || !isWord(source[i - 1])) && (i + 4 >= n || !isWord(source[i + 4]))) {
+            size_t j = i + 4;
+            j = scan::skipSpace(source.data(), j, n);
+            size_t nameBegin = j;
+            while (j < n && isWord(source[j])) ++j;
+            funcs.push_back({source.substr(nameBegin, j - nameBegin), i, n});
+            open = true;
+            i = j - 1;
+        } else if (isWord(c)) {
+            while (i + 1 < n && isWord(source[i + 1])) ++i; // skip the rest of the word
+        }
     }
-    switch (c) {
-        case '+': case '-': case '*': case '/': {
-            std::string op(1, get());
-            return {TokenType::Operator, op, startLine, startCol};
+    return funcs;
+}
+
+SourceLocation LineIndex::locate(size_t offset) const {
+    if (lineStarts.empty()) {
+        lineStarts.push_back(0);
+        const char* s = source.data();
+        size_t n = source.size();
+        for (size_t i = scan::find(s, 0, n, '\n'); i < n; i = scan::find(s, i + 1, n, '\n')) {
+            lineStarts.push_back(i + 1);
         }
-        case '(': get(); return {TokenType::LParen, "(", startLine, startCol};
-        case ')': get(); return {TokenType::RParen, ")", startLine, startCol};
-        case '[': get(); return {TokenType::LBracket, "[", startLine, startCol};
-        case ']': get(); return {TokenType::RBracket, "]", startLine, startCol};
-        case '{': get(); return {TokenType::LBrace, "{", startLine, startCol};
-        case '}': get(); return {TokenType::RBrace, "}", startLine, startCol};
-        case ',': get(); return {TokenType::Comma, ",", startLine, startCol};
     }
-    // Unknown character
-    get();
-    return {TokenType::Unknown, std::string(1, c), startLine, startCol};
+    auto line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - 1;
+    return {static_cast<int>(line - lineStarts.begin()) + 1, static_cast<int>(offset - *line) + 1};
 }
 
 std::string Token::toString() const {
     std::ostringstream oss;
-    oss << "Token(" << static_cast<int>(type) << ", '" << value << "', " << line << ", " << column << ")";
+    oss << "Token(" << static_cast<int>(type) << ", '" << value << "', @" << offset << ")";
     return oss.str();
 } 
\ No newline at end of file
@@ -17,6 +17,7 @@ enum class TokenType {
     LBrace,
     RBrace,
     Comma,
+    Colon,
     Assign,
     EndOfFile,
     Unknown
@@ -25,11 +26,37 @@ enum class TokenType {
 struct Token {
     TokenType type;
     std::string value;
-    int line;
-    int column;
+    size_t offset; // byte offset of the token in the source; see LineIndex
     std::string toString() const;
 };
 
+struct SourceLocation {
+    int line;   // 1-based
+    int column; // 1-based, in bytes
+};
+
+// Maps byte offsets back to line and column. Tokens only record offsets; the table of
+// line starts is built the first time a location is asked for, typically for an error.
+class LineIndex {
+public:
+    explicit LineIndex(const std::string& source) : source(source) {}
+    SourceLocation locate(size_t offset) const;
+private:
+    const std::string& source;
+    mutable std::vector<size_t> lineStarts;
+};
+
+// A top-level `func name(...) { ... }` found by findTopLevelFuncs: source[begin, end)
+struct TopLevelFunc {
+    std::string name;
+    size_t begin;
+    size_t end;
+};
+
+// Finds the functions declared at brace depth zero without tokenizing, skipping strings,
+// comments and #use lines. A function whose body is never closed runs to the end of source.
+std::vector<TopLevelFunc> findTopLevelFuncs(const std::string& source);
+
 class Lexer {
 public:
     Lexer(const std::string& src);
@@ -37,10 +64,7 @@ public:
 private:
     std::string source;
     size_t pos;
-    int line;
-    int column;
-    char peek() const;
-    char get();
+    char peek(size_t ahead = 0) const;
     void skipWhitespace();
     Token nextToken();
 }; 
\ No newline at end of file
@@ -1,34 +1,162 @@
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <sstream>
-#include "lexer.h"
-#include "parser.h"
+#include <string>
+#include <vector>
+#include "ast_cache.h"
 #include "ast_printer.h"
-#include "interpreter.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "zen.h"
+
+// Exit status of a script stopped by --fuel, --max-memory, --timeout or --max-depth, or out of stack
+static const int BUDGET_EXCEEDED_STATUS = 3;
+
+// Runs every .mylang script in dir on the thread pool. Each script gets its own context,
+// limits and output buffer; outputs are printed in file name order once all have finished.
+static int runBatch(const std::string& dir, const zen::Limits& limits) {
+    std::vector<std::string> scripts;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".mylang") scripts.push_back(entry.path().string());
+    }
+    std::sort(scripts.begin(), scripts.end());
+
+    struct Result {
+        std::string output;
+        std::string error;
+    };
+    std::vector<Result> results(scripts.size());
+    ThreadPool::instance().parallelFor(scripts.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::ostringstream out;
+            try {
+                zen::Context context(compileFileCached(scripts[i]), out);
+                context.setLimits(limits);
+                context.run();
+            } catch (const std::exception& e) {
+                results[i].error = e.what();
+            }
+            results[i].output = out.str();
+        }
+    });
+
+    int failed = 0;
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        std::cout << "==> " << scripts[i] << " <==\n" << results[i].output;
+        if (!results[i].error.empty()) {
+            std::cerr << scripts[i] << ": Error: " << results[i].error << "\n";
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
+
+static int usage(const char* self) {
+    std::cerr << "Usage: " << self << " [--timings] [--profile] [--profile-out <file>] [limits] <source_file>\n";
+    std::cerr << "       " << self << " [limits] --batch <dir>\n";
+    std::cerr << "Limits: --fuel <steps> --max-memory <bytes, or with K/M/G> --timeout <ms> --max-depth <calls>\n";
+    return 1;
+}
+
+// Parses a byte count such as 65536, 512K, 64M or 2G; 0 if malformed
+static size_t parseBytes(const std::string& text) {
+    char* end = nullptr;
+    double n = std::strtod(text.c_str(), &end);
+    std::string suffix(end);
+    double scale = suffix.empty() ? 1 : suffix == "K" || suffix == "k" ? 1024.0
+                 : suffix == "M" || suffix == "m" ? 1024.0 * 1024 : suffix == "G" || suffix == "g" ? 1024.0 * 1024 * 1024 : 0;
+    return n > 0 ? static_cast<size_t>(n * scale) : 0;
+}
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <source_file>\n";
-        return 1;
+    bool timings = false;
+    bool profile = false;
+    std::string profileOut = "profile.folded";
+    zen::Limits limits;
+    std::string path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch") {
+            if (i + 1 >= argc) return usage(argv[0]);
+            try {
+                return runBatch(argv[i + 1], limits);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+        } else if (arg == "--timings") {
+            timings = true;
+        } else if (arg == "--fuel" || arg == "--max-memory" || arg == "--timeout" || arg == "--max-depth") {
+            if (i + 1 >= argc) return usage(argv[0]);
+            std::string value = argv[++i];
+            bool valid;
+            if (arg == "--fuel") {
+                limits.fuel = std::strtoull(value.c_str(), nullptr, 10);
+                valid = limits.fuel > 0;
+            } else if (arg == "--max-memory") {
+                limits.memoryBytes = parseBytes(value);
+                valid = limits.memoryBytes > 0;
+            } else if (arg == "--max-depth") {
+                limits.callDepth = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+                valid = limits.callDepth > 0;
+            } else {
+                limits.deadlineMs = std::strtod(value.c_str(), nullptr);
+                valid = limits.deadlineMs > 0;
+            }
+            if (!valid) return usage(argv[0]);
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--profile-out") {
+            if (i + 1 >= argc) return usage(argv[0]);
+            profile = true;
+            profileOut = argv[++i];
+        } else if (path.empty()) {
+            path = arg;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (path.empty()) return usage(argv[0]);
+
+    CompileStats stats;
+    double runMs = 0;
+    int status = 0;
+    std::shared_ptr<const Program> program;
+    try {
+        program = compileFileCached(path, &stats);
+        // Print AST (optional for debugging)
+        // for (const auto& node : program->ast) {
+        //     printAST(node.get());
+        // }
+        auto start = std::chrono::steady_clock::now();
+        if (profile) profiler::start();
+        zen::Context context(program);
+        context.setLimits(limits);
+        context.run();
+        runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } catch (const BudgetExceeded& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = BUDGET_EXCEEDED_STATUS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = 1;
+    }
+    if (profile && program) {
+        // A failed run still reports what it did up to the error
+        profiler::stop();
+        std::ofstream folded(profileOut);
+        if (!folded) std::cerr << "Error: cannot write " << profileOut << "\n";
+        profiler::report(*program, path, std::cerr, folded);
     }
-    std::ifstream file(argv[1]);
-    if (!file) {
-        std::cerr << "Could not open file: " << argv[1] << "\n";
-        return 1;
+    if (timings) {
+        std::cerr << "timings: read " << stats.readMs << " ms, "
+                  << (stats.cacheHit ? "cache load " : "parse ") << stats.compileMs << " ms";
+        if (!stats.cacheHit) std::cerr << ", cache write " << stats.writeMs << " ms";
+        std::cerr << ", run " << runMs << " ms (" << (stats.cacheHit ? "warm" : "cold") << " start)\n";
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-
-    Lexer lexer(source);
-    auto tokens = lexer.tokenize();
-    Parser parser(tokens);
-    auto ast = parser.parse();
-    // Print AST (optional for debugging)
-    // for (const auto& node : ast) {
-    //     printAST(node.get());
-    // }
-    Interpreter interpreter;
-    interpreter.interpret(ast);
-    return 0;
-} 
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,69 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZEN_HAVE_MMAP 1
+#endif
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path, Access access) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->filePath = path;
+    file->writable = access == Access::CopyOnWrite;
+#ifdef ZEN_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Could not open file: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat file: " + path);
+    }
+    file->length = static_cast<size_t>(st.st_size);
+    if (file->length > 0) {
+        int prot = file->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* data = mmap(nullptr, file->length, prot, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map file: " + path);
+        }
+        file->bytes = static_cast<const char*>(data);
+        file->mapped = true;
+    }
+    close(fd);
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("Could not open file: " + path);
+    file->length = static_cast<size_t>(in.tellg());
+    file->buffer.reset(new char[file->length + 1]);
+    in.seekg(0);
+    in.read(file->buffer.get(), static_cast<std::streamsize>(file->length));
+    file->bytes = file->buffer.get();
+#endif
+    return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef ZEN_HAVE_MMAP
+    if (mapped) munmap(const_cast<char*>(bytes), length);
+#endif
+}
+
+void MappedFile::releaseBefore(size_t end) const {
+#ifdef ZEN_HAVE_MMAP
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    end = end / page * page;
+    if (mapped && end > 0) madvise(const_cast<char*>(bytes), end, MADV_DONTNEED);
+#else
+    (void)end;
+#endif
+}
+
+void MappedFile::adviseSequential() const {
+#ifdef ZEN_HAVE_MMAP
+    if (mapped) madvise(const_cast<char*>(bytes), length, MADV_SEQUENTIAL);
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// View of a whole file. Where mmap is available the file is mapped, so pages are read on
+// demand and shared with the page cache; elsewhere it is read into memory.
+class MappedFile {
+public:
+    // CopyOnWrite mappings may be written through mutableBytes(); written pages become
+    // private to this process and the file itself never changes
+    enum class Access { ReadOnly, CopyOnWrite };
+
+    // Throws std::runtime_error if the file cannot be opened
+    static std::shared_ptr<const MappedFile> open(const std::string& path, Access access = Access::ReadOnly);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    const std::string& path() const { return filePath; }
+    // Writable bytes of a CopyOnWrite file; nullptr for a read-only one
+    char* mutableBytes() const { return writable ? const_cast<char*>(bytes) : nullptr; }
+    // Tells the kernel the file will be read front to back, so it reads ahead aggressively
+    void adviseSequential() const;
+    // Drops the resident pages of [0, end) from this process. They are read back from the
+    // file if touched again, so views into that range stay valid. Not for written
+    // CopyOnWrite pages, which it would revert.
+    void releaseBefore(size_t end) const;
+
+private:
+    MappedFile() = default;
+    std::string filePath;
+    const char* bytes = "";
+    size_t length = 0;
+    bool mapped = false;
+    bool writable = false;
+    std::unique_ptr<char[]> buffer; // used when mmap is not available
+};
@@ -0,0 +1,184 @@
+#include "matrix.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ZEN_MATRIX_X86 1
+#define ZEN_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define ZEN_MATRIX_X86 1
+#define ZEN_TARGET_AVX2_FMA
+#include <immintrin.h>
+#endif
+
+std::vector<double>& Matrix::mutableData() {
+    if (data.use_count() > 1) data = std::make_shared<MatrixData>(*data);
+    return *data;
+}
+
+Matrix makeMatrix(size_t rows, size_t cols) {
+    budget::checkRoom(rows * cols * sizeof(double));
+    return Matrix{rows, cols, std::make_shared<MatrixData>(rows * cols, 0.0)};
+}
+
+Matrix transpose(const Matrix& m) {
+    Matrix t = makeMatrix(m.cols, m.rows);
+    const double* src = m.values();
+    double* dst = t.data->data();
+    // Walk 32x32 tiles so both the reads and the writes stay within a few cache lines
+    const size_t tile = 32;
+    for (size_t i0 = 0; i0 < m.rows; i0 += tile) {
+        size_t i1 = std::min(i0 + tile, m.rows);
+        for (size_t j0 = 0; j0 < m.cols; j0 += tile) {
+            size_t j1 = std::min(j0 + tile, m.cols);
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) dst[j * m.rows + i] = src[i * m.cols + j];
+            }
+        }
+    }
+    return t;
+}
+
+namespace {
+
+// Register tile of C (MR x NR) and cache blocks: an MC x KC panel of A stays in L2,
+// a KC x NR sliver of B in L1
+constexpr size_t MR = 4;
+constexpr size_t NR = 8;
+constexpr size_t MC = 96;
+constexpr size_t KC = 256;
+constexpr size_t NC = 2048;
+
+// Products below this many multiply-adds are not worth spreading over threads
+constexpr size_t PARALLEL_THRESHOLD = size_t(1) << 21;
+
+// Packs an mc x kc block of A into MR-row panels stored column by column, zero-padded
+void packA(const double* a, size_t lda, size_t mc, size_t kc, double* out) {
+    for (size_t i = 0; i < mc; i += MR) {
+        size_t mr = std::min(MR, mc - i);
+        for (size_t p = 0; p < kc; ++p) {
+            for (size_t r = 0; r < MR; ++r) *out++ = r < mr ? a[(i + r) * lda + p] : 0.0;
+        }
+    }
+}
+
+// Packs a kc x nc block of B into NR-column panels stored row by row, zero-padded
+void packB(const double* b, size_t ldb, size_t kc, size_t nc, double* out) {
+    for (size_t j = 0; j < nc; j += NR) {
+        size_t nr = std::min(NR, nc - j);
+        for (size_t p = 0; p < kc; ++p) {
+            const double* row = b + p * ldb + j;
+            for (size_t c = 0; c < NR; ++c) *out++ = c < nr ? row[c] : 0.0;
+        }
+    }
+}
+
+// tile[MR][NR] = packed A panel (kc x MR) times packed B panel (kc x NR)
+using MicroKernel = void (*)(size_t kc, const double* a, const double* b, double* tile);
+
+void microKernelPortable(size_t kc, const double* a, const double* b, double* tile) {
+    double acc[MR][NR] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t r = 0; r < MR; ++r) {
+            double ar = a[p * MR + r];
+            for (size_t c = 0; c < NR; ++c) acc[r][c] += ar * b[p * NR + c];
+        }
+    }
+    for (size_t r = 0; r < MR; ++r) {
+        for (size_t c = 0; c < NR; ++c) tile[r * NR + c] = acc[r][c];
+    }
+}
+
+#ifdef ZEN_MATRIX_X86
+// 4x8 tile held in eight ymm accumulators, one broadcast of A per row and step
+ZEN_TARGET_AVX2_FMA void microKernelAvx2(size_t kc, const double* a, const double* b, double* tile) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    for (size_t p = 0; p < kc; ++p) {
+        __m256d b0 = _mm256_loadu_pd(b + p * NR);
+        __m256d b1 = _mm256_loadu_pd(b + p * NR + 4);
+        __m256d a0 = _mm256_broadcast_sd(a + p * MR);
+        c00 = _mm256_fmadd_pd(a0, b0, c00);
+        c01 = _mm256_fmadd_pd(a0, b1, c01);
+        __m256d a1 = _mm256_broadcast_sd(a + p * MR + 1);
+        c10 = _mm256_fmadd_pd(a1, b0, c10);
+        c11 = _mm256_fmadd_pd(a1, b1, c11);
+        __m256d a2 = _mm256_broadcast_sd(a + p * MR + 2);
+        c20 = _mm256_fmadd_pd(a2, b0, c20);
+        c21 = _mm256_fmadd_pd(a2, b1, c21);
+        __m256d a3 = _mm256_broadcast_sd(a + p * MR + 3);
+        c30 = _mm256_fmadd_pd(a3, b0, c30);
+        c31 = _mm256_fmadd_pd(a3, b1, c31);
+    }
+    _mm256_storeu_pd(tile, c00);
+    _mm256_storeu_pd(tile + 4, c01);
+    _mm256_storeu_pd(tile + 8, c10);
+    _mm256_storeu_pd(tile + 12, c11);
+    _mm256_storeu_pd(tile + 16, c20);
+    _mm256_storeu_pd(tile + 20, c21);
+    _mm256_storeu_pd(tile + 24, c30);
+    _mm256_storeu_pd(tile + 28, c31);
+}
+#endif
+
+MicroKernel selectMicroKernel() {
+#ifdef ZEN_MATRIX_X86
+    if (simd::level() == simd::Level::Avx2) return microKernelAvx2;
+#endif
+    return microKernelPortable;
+}
+
+// Accumulates rows [rowBegin, rowEnd) of C = A * B. Each caller packs its own panels,
+// so disjoint row ranges can run concurrently.
+void multiplyRows(const Matrix& A, const Matrix& B, double* C, size_t rowBegin, size_t rowEnd) {
+    static const MicroKernel kernel = selectMicroKernel();
+    const size_t n = B.cols, k = A.cols;
+    std::vector<double> packedA(MC * KC);
+    std::vector<double> packedB(KC * ((NC + NR - 1) / NR * NR));
+    double tile[MR * NR];
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = std::min(NC, n - jc);
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = std::min(KC, k - pc);
+            packB(B.values() + pc * n + jc, n, kc, nc, packedB.data());
+            for (size_t ic = rowBegin; ic < rowEnd; ic += MC) {
+                size_t mc = std::min(MC, rowEnd - ic);
+                packA(A.values() + ic * k + pc, k, mc, kc, packedA.data());
+                for (size_t jr = 0; jr < nc; jr += NR) {
+                    size_t nr = std::min(NR, nc - jr);
+                    for (size_t ir = 0; ir < mc; ir += MR) {
+                        size_t mr = std::min(MR, mc - ir);
+                        kernel(kc, packedA.data() + ir * kc, packedB.data() + jr * kc, tile);
+                        for (size_t r = 0; r < mr; ++r) {
+                            double* out = C + (ic + ir + r) * n + jc + jr;
+                            for (size_t c = 0; c < nr; ++c) out[c] += tile[r * NR + c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+Matrix matmul(const Matrix& a, const Matrix& b) {
+    Matrix c = makeMatrix(a.rows, b.cols);
+    if (a.rows == 0 || b.cols == 0 || a.cols == 0) return c;
+    double* out = c.data->data();
+    size_t work = a.rows * b.cols * a.cols;
+    auto& pool = ThreadPool::instance();
+    if (work < PARALLEL_THRESHOLD || pool.size() < 2) {
+        multiplyRows(a, b, out, 0, a.rows);
+        return c;
+    }
+    // Split C into row bands of MC rows; idle threads steal bands from busy ones
+    pool.parallelFor(a.rows, MC, [&](size_t begin, size_t end) {
+        multiplyRows(a, b, out, begin, end);
+    });
+    return c;
+}
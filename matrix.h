@@ -0,0 +1,28 @@
+#pragma once
+#include "budget.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Matrix elements, counted against the memory budget
+struct MatrixData : std::vector<double> {
+    using std::vector<double>::vector;
+    budget::Charge charge{capacity() * sizeof(double)};
+};
+
+// Dense row-major matrix of doubles. Copies share storage until one of them is written.
+struct Matrix {
+    size_t rows = 0;
+    size_t cols = 0;
+    std::shared_ptr<MatrixData> data;
+    const double* values() const { return data->data(); }
+    double at(size_t r, size_t c) const { return (*data)[r * cols + c]; }
+    // Unshares the storage before an in-place write
+    std::vector<double>& mutableData();
+};
+
+// Zero-filled rows x cols matrix
+Matrix makeMatrix(size_t rows, size_t cols);
+Matrix transpose(const Matrix& m);
+// Cache-blocked product; large products are split across the thread pool by rows of the result
+Matrix matmul(const Matrix& a, const Matrix& b);
@@ -0,0 +1,164 @@
+#include "module.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Library functions written in the language itself, available as #use <core>
+const char* CORE_SOURCE = R"(
+func abs(x) {
+    if (x < 0) {
+        return 0 - x;
+    }
+    return x;
+}
+func sign(x) {
+    if (x < 0) {
+        return 0 - 1;
+    }
+    if (x > 0) {
+        return 1;
+    }
+    return 0;
+}
+func clamp(x, lo, hi) {
+    if (x < lo) {
+        return lo;
+    }
+    if (x > hi) {
+        return hi;
+    }
+    return x;
+}
+)";
+
+std::vector<std::string> searchPath(const std::string& fromDir) {
+    std::vector<std::string> dirs;
+    dirs.push_back(fromDir.empty() ? "." : fromDir);
+    if (const char* env = std::getenv("ZEN_PATH")) {
+#ifdef _WIN32
+        const char sep = ';';
+#else
+        const char sep = ':';
+#endif
+        std::stringstream list(env);
+        std::string dir;
+        while (std::getline(list, dir, sep)) {
+            if (!dir.empty()) dirs.push_back(dir);
+        }
+    }
+    dirs.push_back("lib");
+    return dirs;
+}
+
+} // namespace
+
+Module::Module(std::string name, std::string path, std::string text)
+    : moduleName(std::move(name)), modulePath(std::move(path)), source(std::move(text)) {
+    baseDir = std::filesystem::path(modulePath).parent_path().string();
+    for (const auto& func : findTopLevelFuncs(source)) {
+        auto entry = std::make_unique<Entry>();
+        entry->begin = func.begin;
+        entry->end = func.end;
+        index.emplace(func.name, std::move(entry)); // the first definition wins
+    }
+    // #use lines at the start of a line
+    for (size_t pos = 0; pos < source.size();) {
+        size_t eol = source.find('\n', pos);
+        if (eol == std::string::npos) eol = source.size();
+        if (source.compare(pos, 4, "#use") == 0) {
+            size_t open = source.find('<', pos);
+            size_t close = source.find('>', pos);
+            if (open < eol && close < eol && open < close) imports.push_back(source.substr(open + 1, close - open - 1));
+        }
+        pos = eol + 1;
+    }
+}
+
+const FunctionNode* Module::find(const std::string& func) const {
+    auto it = index.find(func);
+    if (it == index.end()) return nullptr;
+    Entry& entry = *it->second;
+    if (const FunctionNode* node = entry.parsed.load(std::memory_order_acquire)) return node;
+
+    std::lock_guard<std::mutex> lock(parseMutex);
+    if (const FunctionNode* node = entry.parsed.load(std::memory_order_relaxed)) return node;
+    std::vector<std::unique_ptr<ASTNode>> nodes;
+    try {
+        Lexer lexer(source.substr(entry.begin, entry.end - entry.begin));
+        auto tokens = lexer.tokenize();
+        // Offsets are kept in the whole module source
+        for (auto& token : tokens) token.offset += entry.begin;
+        Parser parser(tokens);
+        nodes = parser.parse();
+    } catch (const ParseError& e) {
+        SourceLocation at = LineIndex(source).locate(e.offset);
+        throw std::runtime_error("Module " + moduleName + ", line " + std::to_string(at.line) + ": " + e.what());
+    }
+    if (nodes.size() != 1 || !dynamic_cast<const FunctionNode*>(nodes[0].get())) {
+        throw std::runtime_error("Module " + moduleName + ": could not parse function " + func);
+    }
+    entry.node = std::move(nodes[0]);
+    auto node = static_cast<const FunctionNode*>(entry.node.get());
+    entry.parsed.store(node, std::memory_order_release);
+    return node;
+}
+
+ModuleCache& ModuleCache::instance() {
+    static ModuleCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Module> ModuleCache::load(const std::string& name, const std::string& fromDir) {
+    std::string key;
+    std::string path;
+    if (name == "core") {
+        key = "<core>";
+    } else {
+        for (const auto& dir : searchPath(fromDir)) {
+            std::filesystem::path candidate = std::filesystem::path(dir) / (name + ".mylang");
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(candidate, ec)) {
+                path = candidate.string();
+                key = std::filesystem::weakly_canonical(candidate, ec).string();
+                break;
+            }
+        }
+        if (key.empty()) throw std::runtime_error("Module not found: " + name);
+    }
+
+    Cached fresh;
+    if (name != "core") {
+        std::error_code ec;
+        fresh.modified = std::filesystem::last_write_time(path, ec);
+        fresh.size = std::filesystem::file_size(path, ec);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = modules.find(key);
+    if (it != modules.end() && it->second.modified == fresh.modified && it->second.size == fresh.size) {
+        return it->second.module;
+    }
+    std::string source;
+    if (name == "core") {
+        source = CORE_SOURCE;
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("Could not open module: " + path);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        source = buffer.str();
+    }
+    fresh.module = std::make_shared<const Module>(name, path, std::move(source));
+    modules[key] = fresh;
+    return fresh.module;
+}
+
+void ModuleCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    modules.clear();
+}
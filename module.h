@@ -0,0 +1,65 @@
+#pragma once
+#include "ast.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A library imported with #use. Loading a module only indexes its top-level functions;
+// each function is lexed and parsed the first time something calls it. Top-level
+// statements other than functions and #use lines are ignored.
+class Module {
+public:
+    Module(std::string name, std::string path, std::string source);
+    const std::string& name() const { return moduleName; }
+    const std::string& path() const { return modulePath; }
+    // Module text, which AST offsets of its functions point into
+    const std::string& text() const { return source; }
+    // Parses the function on first use; nullptr if the module has no such function.
+    // Safe to call from any number of threads.
+    const FunctionNode* find(const std::string& func) const;
+    // Modules named by this module's own #use lines
+    const std::vector<std::string>& uses() const { return imports; }
+    // Directory of the module file, where its own imports are searched first
+    const std::string& dir() const { return baseDir; }
+private:
+    struct Entry {
+        size_t begin;
+        size_t end;
+        std::atomic<const FunctionNode*> parsed{nullptr};
+        std::unique_ptr<ASTNode> node;
+    };
+    std::string moduleName;
+    std::string modulePath;
+    std::string baseDir;
+    std::string source;
+    std::vector<std::string> imports;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> index; // fixed after construction
+    mutable std::mutex parseMutex;
+};
+
+// Process-wide cache of loaded modules, so a library imported by many scripts (or by
+// many contexts of the same script) is read, indexed and parsed once. A module file whose
+// modification time or size has changed is read again by the next load; programs
+// compiled earlier keep the version they loaded.
+class ModuleCache {
+public:
+    static ModuleCache& instance();
+    // Resolves name against fromDir, then each directory of ZEN_PATH, then ./lib.
+    // "core" is built in. Throws if the module cannot be found.
+    std::shared_ptr<const Module> load(const std::string& name, const std::string& fromDir);
+    // Forgets every loaded module, so the next load of each reads its file again
+    void clear();
+private:
+    struct Cached {
+        std::shared_ptr<const Module> module;
+        std::filesystem::file_time_type modified;
+        uintmax_t size = 0;
+    };
+    std::mutex mutex;
+    std::unordered_map<std::string, Cached> modules; // by resolved path
+};
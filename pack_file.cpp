@@ -0,0 +1,118 @@
+#include "pack_file.h"
+#include "mapped_file.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define ZEN_HAVE_FSYNC 1
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'Z', 'P', 'A', 'K'};
+constexpr size_t HEADER_SIZE = 16;
+
+enum class ElementType : uint32_t { Float64 = 1, Float32 = 2, Int64 = 3, Int32 = 4 };
+
+size_t elementSize(ElementType type) {
+    switch (type) {
+        case ElementType::Float64: return 8;
+        case ElementType::Float32: return 4;
+        case ElementType::Int64: return 8;
+        case ElementType::Int32: return 4;
+    }
+    return 0;
+}
+
+template <typename T>
+std::vector<double> widen(const char* data, size_t count) {
+    std::vector<double> out(count);
+    for (size_t i = 0; i < count; ++i) {
+        T x;
+        std::memcpy(&x, data + i * sizeof(T), sizeof(T));
+        out[i] = static_cast<double>(x);
+    }
+    return out;
+}
+
+// Flushes a closed file's data to disk; false if that fails
+bool syncFile(const std::string& path) {
+#ifdef ZEN_HAVE_FSYNC
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+} // namespace
+
+NumPack openPack(const std::string& path, bool copyOnWrite) {
+    auto file = MappedFile::open(path, copyOnWrite ? MappedFile::Access::CopyOnWrite : MappedFile::Access::ReadOnly);
+    if (file->size() < HEADER_SIZE || std::memcmp(file->data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("open_pack: " + path + " is not a pack file");
+    }
+    uint32_t typeCode;
+    uint64_t count;
+    std::memcpy(&typeCode, file->data() + 4, sizeof(typeCode));
+    std::memcpy(&count, file->data() + 8, sizeof(count));
+    auto type = static_cast<ElementType>(typeCode);
+    size_t width = elementSize(type);
+    if (width == 0) throw std::runtime_error("open_pack: " + path + " has unknown element type " + std::to_string(typeCode));
+    if ((file->size() - HEADER_SIZE) / width != count || (file->size() - HEADER_SIZE) % width != 0) {
+        throw std::runtime_error("open_pack: " + path + " is truncated or has trailing data");
+    }
+
+    const char* elements = file->data() + HEADER_SIZE;
+    switch (type) {
+        case ElementType::Float64: break;
+        case ElementType::Float32: return makeNumPack(widen<float>(elements, count));
+        case ElementType::Int64: return makeNumPack(widen<int64_t>(elements, count));
+        case ElementType::Int32: return makeNumPack(widen<int32_t>(elements, count));
+    }
+    // The mapping is page-aligned and the header is 16 bytes, so the doubles are aligned
+    auto storage = std::make_shared<NumStorage>();
+    storage->values = reinterpret_cast<double*>(copyOnWrite ? file->mutableBytes() + HEADER_SIZE : const_cast<char*>(elements));
+    storage->size = count;
+    storage->readOnly = !copyOnWrite;
+    storage->file = std::move(file);
+    return NumPack{std::move(storage), 0, count};
+}
+
+void savePack(const double* values, size_t count, const std::string& path) {
+    char header[HEADER_SIZE];
+    uint32_t type = static_cast<uint32_t>(ElementType::Float64);
+    uint64_t elements = count;
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    std::memcpy(header + 4, &type, sizeof(type));
+    std::memcpy(header + 8, &elements, sizeof(elements));
+
+    // Write a temporary and rename it over the target: a pack mapped from the old file
+    // keeps its pages, and no reader sees half a file
+    std::string tmp = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("save_pack: cannot write " + path);
+    file.write(header, sizeof(header));
+    file.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(double)));
+    file.close();
+    // Put the bytes on disk before the rename does, so a crash cannot leave an empty
+    // or partial file under the target's name
+    if (!file || !syncFile(tmp)) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("save_pack: cannot write " + path);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("save_pack: cannot replace " + path);
+    }
+}
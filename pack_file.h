@@ -0,0 +1,14 @@
+#pragma once
+#include "value.h"
+#include <string>
+
+// Binary pack files for open_pack / save_pack. A file is a 16-byte header (the magic
+// "ZPAK", a uint32 element type and a uint64 element count) followed by the elements in
+// native byte order. float64 packs are mapped and used in place, so a pack larger than
+// memory is paged in and out by the kernel; other element types are converted on open.
+
+// Maps path as a numeric pack. Read-only packs are copied into memory the first time they
+// are written; copy-on-write packs are written in place without changing the file.
+NumPack openPack(const std::string& path, bool copyOnWrite);
+// Writes count doubles as a float64 pack file in one sequential pass
+void savePack(const double* values, size_t count, const std::string& path);
@@ -0,0 +1,394 @@
+#include "interpreter.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+// parfor: iterations run as chunks on the work-stealing pool, each chunk in its own
+// worker interpreter seeded with a snapshot of the enclosing variables.
+//
+// The body may only write
+//   - variables it creates itself (private to the chunk, dropped after the loop),
+//   - slots of enclosing packs indexed by the loop variable (p[i] = ..., m[i][j] = ...),
+//   - enclosing numbers as reductions: s = s + e, s = min(s, e), s = max(s, e).
+// A slot-written container may only be read at the loop variable's slot, and functions
+// the body calls may not use it or the reductions at all. Anything else is rejected
+// before the first iteration runs. A loop writing slots with a fractional start or step
+// runs serially.
+
+namespace {
+
+enum class Reduction { Sum, Min, Max };
+
+struct ParallelPlan {
+    std::unordered_map<std::string, Reduction> reductions;
+    std::unordered_map<std::string, size_t> reductionWrites;
+    std::unordered_set<std::string> slotTargets;
+};
+
+using Scope = std::unordered_map<std::string, Value>;
+
+bool isIdentifier(const ASTNode* node, const std::string& name) {
+    auto id = dynamic_cast<const IdentifierNode*>(node);
+    return id && id->name == name;
+}
+
+// Calls f on each direct child of node, statements and expressions alike
+template <typename F>
+void forEachChild(const ASTNode* node, F&& f) {
+    auto one = [&](const ASTNode* child) {
+        if (child) f(child);
+    };
+    auto all = [&](const std::vector<std::unique_ptr<ASTNode>>& stmts) {
+        for (const auto& s : stmts) one(s.get());
+    };
+    if (auto var = dynamic_cast<const VarDeclNode*>(node)) {
+        one(var->value.get());
+    } else if (auto print = dynamic_cast<const PrintNode*>(node)) {
+        one(print->expr.get());
+    } else if (auto ifNode = dynamic_cast<const IfNode*>(node)) {
+        one(ifNode->condition.get());
+        all(ifNode->thenBranch);
+        all(ifNode->elseBranch);
+    } else if (auto whileNode = dynamic_cast<const WhileNode*>(node)) {
+        one(whileNode->condition.get());
+        all(whileNode->body);
+    } else if (auto forNode = dynamic_cast<const ForNode*>(node)) {
+        one(forNode->condition.get());
+        one(forNode->increment.get());
+        all(forNode->body);
+    } else if (auto forIn = dynamic_cast<const ForInNode*>(node)) {
+        one(forIn->iterable.get());
+        all(forIn->body);
+    } else if (auto sw = dynamic_cast<const SwitchNode*>(node)) {
+        one(sw->expr.get());
+        for (const auto& branch : sw->cases) all(branch.body);
+        all(sw->defaultBody);
+    } else if (auto bin = dynamic_cast<const BinaryExprNode*>(node)) {
+        one(bin->left.get());
+        one(bin->right.get());
+    } else if (auto idx = dynamic_cast<const IndexNode*>(node)) {
+        one(idx->array.get());
+        one(idx->index.get());
+    } else if (auto slice = dynamic_cast<const SliceNode*>(node)) {
+        one(slice->array.get());
+        one(slice->start.get());
+        one(slice->end.get());
+    } else if (auto call = dynamic_cast<const CallNode*>(node)) {
+        for (const auto& arg : call->args) one(arg.get());
+    } else if (auto arr = dynamic_cast<const ArrayNode*>(node)) {
+        for (const auto& el : arr->elements) one(el.get());
+    } else if (auto ret = dynamic_cast<const ReturnNode*>(node)) {
+        one(ret->value.get());
+    } else if (auto spawn = dynamic_cast<const SpawnNode*>(node)) {
+        one(spawn->call.get());
+    } else if (auto await = dynamic_cast<const AwaitNode*>(node)) {
+        one(await->task.get());
+    }
+}
+
+// Number of reads of `name` anywhere under node
+size_t countRefs(const ASTNode* node, const std::string& name) {
+    if (!node) return 0;
+    if (auto id = dynamic_cast<const IdentifierNode*>(node)) return id->name == name ? 1 : 0;
+    size_t n = 0;
+    forEachChild(node, [&](const ASTNode* child) { n += countRefs(child, name); });
+    return n;
+}
+
+// Number of name[loopVar] uses under node, reads and writes alike (m[i][j] counts once)
+size_t countLoopSlots(const ASTNode* node, const std::string& name, const std::string& loopVar) {
+    auto idx = dynamic_cast<const IndexNode*>(node);
+    if (idx && isIdentifier(idx->array.get(), name) && isIdentifier(idx->index.get(), loopVar)) return 1;
+    size_t n = 0;
+    forEachChild(node, [&](const ASTNode* child) { n += countLoopSlots(child, name, loopVar); });
+    return n;
+}
+
+// The user function a call or a bare name under the body would run, if any
+const FunctionNode* calleeOf(const std::string& name, const Scope& outer, const Program& program) {
+    auto var = outer.find(name);
+    if (var != outer.end()) {
+        auto ref = std::get_if<FunctionRef>(&var->second);
+        return ref ? ref->func : nullptr;
+    }
+    return program.findFunction(name);
+}
+
+// Every user function the body can reach: called, spawned or passed on by name, and
+// whatever those call in turn
+void collectCallees(const ASTNode* node, const Scope& outer, const Program& program,
+                    std::unordered_set<const FunctionNode*>& found) {
+    const FunctionNode* func = nullptr;
+    if (auto call = dynamic_cast<const CallNode*>(node)) func = calleeOf(call->func, outer, program);
+    if (auto id = dynamic_cast<const IdentifierNode*>(node)) func = calleeOf(id->name, outer, program);
+    if (func && found.insert(func).second) {
+        for (const auto& stmt : func->body) collectCallees(stmt.get(), outer, program, found);
+    }
+    forEachChild(node, [&](const ASTNode* child) { collectCallees(child, outer, program, found); });
+}
+
+// s = s + e, s = e + s, s = min(s, e), s = max(e, s) ...
+bool matchReduction(const VarDeclNode* var, Reduction& kind) {
+    if (auto bin = dynamic_cast<const BinaryExprNode*>(var->value.get())) {
+        if (bin->op != "+") return false;
+        kind = Reduction::Sum;
+        if (isIdentifier(bin->left.get(), var->name)) return countRefs(bin->right.get(), var->name) == 0;
+        if (isIdentifier(bin->right.get(), var->name)) return countRefs(bin->left.get(), var->name) == 0;
+        return false;
+    }
+    if (auto call = dynamic_cast<const CallNode*>(var->value.get())) {
+        if ((call->func != "min" && call->func != "max") || call->args.size() != 2) return false;
+        kind = call->func == "min" ? Reduction::Min : Reduction::Max;
+        if (isIdentifier(call->args[0].get(), var->name)) return countRefs(call->args[1].get(), var->name) == 0;
+        if (isIdentifier(call->args[1].get(), var->name)) return countRefs(call->args[0].get(), var->name) == 0;
+    }
+    return false;
+}
+
+// The shared pack an expression sorts in place with sort_inplace(x), or nullptr
+const IdentifierNode* inPlaceSortTarget(const ASTNode* node, const Scope& outer) {
+    if (!node) return nullptr;
+    const IdentifierNode* found = nullptr;
+    auto check = [&](const ASTNode* child) {
+        if (!found) found = inPlaceSortTarget(child, outer);
+    };
+    if (auto call = dynamic_cast<const CallNode*>(node)) {
+        if (call->func == "sort_inplace" && call->args.size() == 1) {
+            auto id = dynamic_cast<const IdentifierNode*>(call->args[0].get());
+            if (id && outer.count(id->name)) return id;
+        }
+        for (const auto& arg : call->args) check(arg.get());
+    } else if (auto bin = dynamic_cast<const BinaryExprNode*>(node)) {
+        check(bin->left.get());
+        check(bin->right.get());
+    } else if (auto idx = dynamic_cast<const IndexNode*>(node)) {
+        check(idx->array.get());
+        check(idx->index.get());
+    } else if (auto slice = dynamic_cast<const SliceNode*>(node)) {
+        check(slice->array.get());
+        check(slice->start.get());
+        check(slice->end.get());
+    } else if (auto arr = dynamic_cast<const ArrayNode*>(node)) {
+        for (const auto& el : arr->elements) check(el.get());
+    } else if (auto spawn = dynamic_cast<const SpawnNode*>(node)) {
+        check(spawn->call.get());
+    } else if (auto await = dynamic_cast<const AwaitNode*>(node)) {
+        check(await->task.get());
+    }
+    return found;
+}
+
+void checkNoInPlaceSort(const ASTNode* expr, const Scope& outer) {
+    if (auto id = inPlaceSortTarget(expr, outer)) {
+        throw std::runtime_error("parfor: loop body writes shared variable '" + id->name + "'");
+    }
+}
+
+void analyze(const ASTNode* node, const std::string& loopVar, const Scope& outer, ParallelPlan& plan);
+
+void analyzeAll(const std::vector<std::unique_ptr<ASTNode>>& stmts, const std::string& loopVar, const Scope& outer, ParallelPlan& plan) {
+    for (const auto& s : stmts) analyze(s.get(), loopVar, outer, plan);
+}
+
+void analyzeSlotWrite(const BinaryExprNode* assign, const std::string& loopVar, const Scope& outer, ParallelPlan& plan) {
+    auto idx = dynamic_cast<const IndexNode*>(assign->left.get());
+    if (!idx) throw std::runtime_error("parfor: invalid array assignment");
+    // p[i] = ... writes slot i; m[i][j] = ... writes row i
+    const IndexNode* slot = idx;
+    if (auto row = dynamic_cast<const IndexNode*>(idx->array.get())) slot = row;
+    auto target = dynamic_cast<const IdentifierNode*>(slot->array.get());
+    if (!target) throw std::runtime_error("parfor: array assignment must be to a variable");
+    if (!outer.count(target->name)) return; // pack created inside the body
+    if (!isIdentifier(slot->index.get(), loopVar)) {
+        throw std::runtime_error("parfor: writes to '" + target->name + "' must be indexed by the loop variable '" + loopVar + "'");
+    }
+    plan.slotTargets.insert(target->name);
+}
+
+void analyze(const ASTNode* node, const std::string& loopVar, const Scope& outer, ParallelPlan& plan) {
+    if (auto var = dynamic_cast<const VarDeclNode*>(node)) {
+        checkNoInPlaceSort(var->value.get(), outer);
+        auto bin = dynamic_cast<const BinaryExprNode*>(var->value.get());
+        if (var->name.empty() && bin && bin->op == "[]=") {
+            analyzeSlotWrite(bin, loopVar, outer, plan);
+            return;
+        }
+        if (var->name.empty()) return;
+        if (var->name == loopVar) throw std::runtime_error("parfor: loop variable '" + loopVar + "' cannot be assigned");
+        if (!outer.count(var->name)) return; // private to the iteration
+        Reduction kind;
+        if (!matchReduction(var, kind)) {
+            throw std::runtime_error("parfor: loop body writes shared variable '" + var->name + "'");
+        }
+        auto seen = plan.reductions.find(var->name);
+        if (seen != plan.reductions.end() && seen->second != kind) {
+            throw std::runtime_error("parfor: mixed reductions on '" + var->name + "'");
+        }
+        if (!std::holds_alternative<double>(outer.at(var->name))) {
+            throw std::runtime_error("parfor: reduction variable '" + var->name + "' must be a number");
+        }
+        plan.reductions[var->name] = kind;
+        plan.reductionWrites[var->name]++;
+    } else if (auto print = dynamic_cast<const PrintNode*>(node)) {
+        checkNoInPlaceSort(print->expr.get(), outer);
+    } else if (auto ifNode = dynamic_cast<const IfNode*>(node)) {
+        checkNoInPlaceSort(ifNode->condition.get(), outer);
+        analyzeAll(ifNode->thenBranch, loopVar, outer, plan);
+        analyzeAll(ifNode->elseBranch, loopVar, outer, plan);
+    } else if (auto whileNode = dynamic_cast<const WhileNode*>(node)) {
+        checkNoInPlaceSort(whileNode->condition.get(), outer);
+        analyzeAll(whileNode->body, loopVar, outer, plan);
+    } else if (auto forNode = dynamic_cast<const ForNode*>(node)) {
+        const std::string& inner = dynamic_cast<const IdentifierNode*>(forNode->init.get())->name;
+        if (inner == loopVar) throw std::runtime_error("parfor: loop variable '" + loopVar + "' cannot be assigned");
+        if (outer.count(inner)) throw std::runtime_error("parfor: loop body writes shared variable '" + inner + "'");
+        analyzeAll(forNode->body, loopVar, outer, plan);
+    } else if (auto forIn = dynamic_cast<const ForInNode*>(node)) {
+        if (forIn->var == loopVar) throw std::runtime_error("parfor: loop variable '" + loopVar + "' cannot be assigned");
+        if (outer.count(forIn->var)) throw std::runtime_error("parfor: loop body writes shared variable '" + forIn->var + "'");
+        checkNoInPlaceSort(forIn->iterable.get(), outer);
+        analyzeAll(forIn->body, loopVar, outer, plan);
+    } else if (auto sw = dynamic_cast<const SwitchNode*>(node)) {
+        checkNoInPlaceSort(sw->expr.get(), outer);
+        for (const auto& branch : sw->cases) analyzeAll(branch.body, loopVar, outer, plan);
+        analyzeAll(sw->defaultBody, loopVar, outer, plan);
+    } else if (dynamic_cast<const ReturnNode*>(node)) {
+        throw std::runtime_error("parfor: 'return' is not allowed in a parallel loop body");
+    }
+}
+
+ParallelPlan analyzeParallelFor(const ForNode* forNode, const std::string& loopVar, const Scope& outer, const Program& program) {
+    ParallelPlan plan;
+    analyzeAll(forNode->body, loopVar, outer, plan);
+    // Other workers are writing the rest of a slot-written container meanwhile
+    for (const auto& name : plan.slotTargets) {
+        size_t refs = 0, slots = 0;
+        for (const auto& stmt : forNode->body) {
+            refs += countRefs(stmt.get(), name);
+            slots += countLoopSlots(stmt.get(), name, loopVar);
+        }
+        if (refs != slots) {
+            throw std::runtime_error("parfor: '" + name + "' is written by the loop, so it may only be used as " + name + "[" + loopVar + "]");
+        }
+    }
+    // Called functions see the caller's variables, so they must not touch the ones the
+    // workers share
+    std::unordered_set<const FunctionNode*> callees;
+    for (const auto& stmt : forNode->body) collectCallees(stmt.get(), outer, program, callees);
+    std::vector<std::string> shared(plan.slotTargets.begin(), plan.slotTargets.end());
+    for (const auto& [name, kind] : plan.reductions) shared.push_back(name);
+    for (const FunctionNode* func : callees) {
+        for (const auto& name : shared) {
+            if (std::find(func->params.begin(), func->params.end(), name) != func->params.end()) continue;
+            size_t refs = 0;
+            for (const auto& stmt : func->body) refs += countRefs(stmt.get(), name);
+            if (refs) {
+                throw std::runtime_error("parfor: function '" + func->name + "' called in the loop body uses shared variable '" + name + "'");
+            }
+        }
+    }
+    // An accumulator may only be read by its own update, since partial sums are per chunk
+    for (const auto& [name, kind] : plan.reductions) {
+        size_t reads = 0;
+        for (const auto& stmt : forNode->body) reads += countRefs(stmt.get(), name);
+        if (reads != plan.reductionWrites[name]) {
+            throw std::runtime_error("parfor: reduction variable '" + name + "' is read inside the loop body");
+        }
+    }
+    return plan;
+}
+
+double combine(Reduction kind, double a, double b) {
+    switch (kind) {
+        case Reduction::Sum: return a + b;
+        case Reduction::Min: return simd::min(a, b);
+        case Reduction::Max: return simd::max(a, b);
+    }
+    return a;
+}
+
+} // namespace
+
+bool Interpreter::execParallelFor(const ForNode* forNode, const std::string& varName, double start, double end, double step) {
+    if (step == 0) throw std::runtime_error("parfor: step must not be zero");
+    double span = std::floor((end - start) / step + 1e-9);
+    if (span < 0) return true;
+    size_t count = static_cast<size_t>(span) + 1;
+
+    // In a task the enclosing scope includes what it inherited from the main program
+    if (inherited) {
+        for (const auto& [name, value] : *inherited) variables.emplace(name, value);
+    }
+    ParallelPlan plan = analyzeParallelFor(forNode, varName, variables, *program);
+    // Slots are indexed by the truncated loop variable; with a fractional start or step
+    // neighbouring iterations can truncate to one slot and land in different chunks
+    if (!plan.slotTargets.empty() && (start != std::floor(start) || step != std::floor(step))) return false;
+
+    // Slot-written containers must be owned by this scope alone so workers can write into
+    // them in place; nested parfors keep writing to the outermost loop's containers
+    auto targets = sharedTargets;
+    for (const auto& name : plan.slotTargets) {
+        bool shared = false;
+        Value* target = findWriteTarget(name, shared);
+        if (!shared) {
+            if (std::holds_alternative<NumPack>(*target)) std::get<NumPack>(*target).mutableData();
+            if (std::holds_alternative<Pack>(*target)) std::get<Pack>(*target).mutableData();
+            if (std::holds_alternative<Matrix>(*target)) std::get<Matrix>(*target).mutableData();
+        }
+        targets[name] = target;
+    }
+    // Workers copy from this snapshot, never from the live variables they may be writing into
+    const Scope snapshot = variables;
+
+    auto& pool = ThreadPool::instance();
+    size_t grain = std::max<size_t>(1, count / (pool.size() * 8));
+    size_t chunks = (count + grain - 1) / grain;
+    std::vector<std::unordered_map<std::string, double>> partials(chunks);
+    // Each chunk prints into its own buffer; buffers are written out in iteration order
+    std::vector<std::string> printed(chunks);
+
+    pool.parallelFor(count, grain, [&](size_t begin, size_t finish) {
+        budget::Scope scope(meter);
+        std::ostringstream chunkOut;
+        Interpreter worker(program, chunkOut);
+        worker.meter = meter;
+        // The chunk may run on this thread, below the calls already made
+        worker.callDepth = callDepth;
+        worker.maxCallDepth = maxCallDepth;
+        worker.variables = snapshot;
+        worker.sharedTargets = targets;
+        // Samples taken in the body show the calls that led to the loop
+        worker.profileStack = profileStack;
+        for (const auto& [name, kind] : plan.reductions) {
+            if (kind == Reduction::Sum) worker.variables[name] = 0.0;
+        }
+        for (size_t k = begin; k < finish; ++k) {
+            worker.variables[varName] = start + static_cast<double>(k) * step;
+            worker.tick();
+            for (const auto& stmt : forNode->body) worker.exec(stmt.get());
+        }
+        // Tasks spawned in this chunk belong to its worker and finish with it
+        worker.drainTasks();
+        printed[begin / grain] = chunkOut.str();
+        auto& partial = partials[begin / grain];
+        for (const auto& [name, kind] : plan.reductions) {
+            const Value& v = worker.variables[name];
+            if (!std::holds_alternative<double>(v)) throw std::runtime_error("parfor: reduction variable '" + name + "' must stay a number");
+            partial[name] = std::get<double>(v);
+        }
+    });
+
+    for (const auto& text : printed) out << text;
+    // Fold chunk results in iteration order so sums are reproducible run to run
+    for (const auto& [name, kind] : plan.reductions) {
+        double acc = std::get<double>(variables[name]);
+        for (const auto& partial : partials) acc = combine(kind, acc, partial.at(name));
+        variables[name] = acc;
+    }
+    variables[varName] = start + static_cast<double>(count - 1) * step;
+    return true;
+}
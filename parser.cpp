@@ -1,5 +1,8 @@
 #include "parser.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <unordered_set>
 
 Parser::Parser(const std::vector<Token>& tokens)
     : tokens(tokens), pos(0) {}
@@ -29,15 +32,38 @@ bool Parser::isAtEnd() const {
 
 std::vector<std::unique_ptr<ASTNode>> Parser::parse() {
     std::vector<std::unique_ptr<ASTNode>> nodes;
-    while (!isAtEnd()) {
-        auto stmt = parseStatement();
-        if (stmt) nodes.push_back(std::move(stmt));
-        else advance(); // Skip invalid token
+    try {
+        while (!isAtEnd()) {
+            auto stmt = parseStatement();
+            if (stmt) nodes.push_back(std::move(stmt));
+            else advance(); // Skip invalid token
+        }
+    } catch (const std::runtime_error& e) {
+        throw ParseError(e.what(), peek().offset);
     }
     return nodes;
 }
 
 std::unique_ptr<ASTNode> Parser::parseStatement() {
+    size_t start = peek().offset;
+    auto stmt = parseStatementKind();
+    if (stmt) stmt->offset = start;
+    return stmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseStatementKind() {
+    // Module import: #use <name>
+    if (peek().type == TokenType::Header) {
+        const std::string& header = peek().value;
+        size_t open = header.find('<');
+        size_t close = header.find('>', open == std::string::npos ? 0 : open);
+        if (header.compare(0, 4, "#use") != 0 || open == std::string::npos || close == std::string::npos) {
+            throw std::runtime_error("Expected '#use <module>'");
+        }
+        std::string module = header.substr(open + 1, close - open - 1);
+        advance();
+        return std::make_unique<UseNode>(module);
+    }
     // Function definition
     if (peek().type == TokenType::Keyword && peek().value == "func") {
         return parseFunction();
@@ -85,10 +111,21 @@ std::unique_ptr<ASTNode> Parser::parseStatement() {
     if (peek().type == TokenType::Keyword && peek().value == "while") {
         return parseWhile();
     }
-    // For statement
-    if (peek().type == TokenType::Keyword && peek().value == "for") {
+    // Switch statement
+    if (peek().type == TokenType::Keyword && peek().value == "switch") {
+        return parseSwitch();
+    }
+    // For statement (parfor runs its iterations in parallel)
+    if (peek().type == TokenType::Keyword && (peek().value == "for" || peek().value == "parfor")) {
         return parseFor();
     }
+    // Expression statement: f(x); spawn f(x); await t;
+    if ((peek().type == TokenType::Identifier && peek(1).type == TokenType::LParen) ||
+        (peek().type == TokenType::Keyword && (peek().value == "spawn" || peek().value == "await"))) {
+        auto expr = parseExpression();
+        if (peek().type == TokenType::Operator && peek().value == ";") advance(); // optional semicolon
+        return std::make_unique<VarDeclNode>("", std::move(expr));
+    }
     // TODO: Add more statement types
     return nullptr;
 }
@@ -142,15 +179,35 @@ std::unique_ptr<ExprNode> Parser::parsePrimary() {
         advance(); // consume ']'
         return std::make_unique<ArrayNode>(std::move(elements));
     }
-    // Function call: len(expr)
-    if (peek().type == TokenType::Keyword && peek().value == "len") {
+    // spawn f(args)
+    if (peek().type == TokenType::Keyword && peek().value == "spawn") {
+        advance(); // consume 'spawn'
+        if (peek().type != TokenType::Identifier || peek(1).type != TokenType::LParen) {
+            throw std::runtime_error("Expected function call after 'spawn'");
+        }
+        std::unique_ptr<CallNode> call(static_cast<CallNode*>(parsePrimary().release()));
+        return std::make_unique<SpawnNode>(std::move(call));
+    }
+    // await task
+    if (peek().type == TokenType::Keyword && peek().value == "await") {
+        advance(); // consume 'await'
+        return std::make_unique<AwaitNode>(parsePrimary());
+    }
+    // Function call: name(expr, ...). map is reserved as a type name but also names a builtin.
+    if ((peek().type == TokenType::Identifier && peek(1).type == TokenType::LParen) ||
+        (peek().type == TokenType::Keyword && peek().value == "len") ||
+        (peek().type == TokenType::Keyword && peek().value == "map" && peek(1).type == TokenType::LParen)) {
         std::string func = peek().value;
         advance();
         if (peek().type != TokenType::LParen) throw std::runtime_error("Expected '(' after function name");
         advance(); // consume '('
         std::vector<std::unique_ptr<ExprNode>> args;
         if (peek().type != TokenType::RParen) {
-            args.push_back(parseExpression());
+            while (true) {
+                args.push_back(parseExpression());
+                if (peek().type == TokenType::Comma) advance();
+                else break;
+            }
         }
         if (peek().type != TokenType::RParen) throw std::runtime_error("Expected ')' after function argument");
         advance(); // consume ')'
@@ -190,7 +247,18 @@ std::unique_ptr<ExprNode> Parser::parsePrimary() {
     auto expr = primary();
     while (peek().type == TokenType::LBracket) {
         advance(); // consume '['
-        auto index = parseExpression();
+        std::unique_ptr<ExprNode> index;
+        if (peek().type != TokenType::Colon) index = parseExpression();
+        // Slice: expr[start:end], with either bound optional
+        if (peek().type == TokenType::Colon) {
+            advance(); // consume ':'
+            std::unique_ptr<ExprNode> end;
+            if (peek().type != TokenType::RBracket) end = parseExpression();
+            if (peek().type != TokenType::RBracket) throw std::runtime_error("Expected ']' after slice");
+            advance(); // consume ']'
+            expr = std::make_unique<SliceNode>(std::move(expr), std::move(index), std::move(end));
+            continue;
+        }
         if (peek().type != TokenType::RBracket) throw std::runtime_error("Expected ']' after array index");
         advance(); // consume ']'
         expr = std::make_unique<IndexNode>(std::move(expr), std::move(index));
@@ -211,7 +279,9 @@ int getPrecedence(const std::string& op) {
 
 std::unique_ptr<ExprNode> Parser::parseBinary(int precedence) {
     auto left = parsePrimary();
-    while (peek().type == TokenType::Operator && getPrecedence(peek().value) >= precedence) {
+    // ';' is lexed as an operator but has no precedence, so it ends the expression
+    while (peek().type == TokenType::Operator && getPrecedence(peek().value) > 0 &&
+           getPrecedence(peek().value) >= precedence) {
         std::string op = peek().value;
         int opPrec = getPrecedence(op);
         advance(); // consume operator
@@ -271,9 +341,8 @@ std::unique_ptr<ASTNode> Parser::parseWhile() {
         auto stmt = parseStatement();
         if (stmt) {
             body.push_back(std::move(stmt));
-            // Require semicolon after each statement in the block
+            // Statements that end in ';' consume it themselves; a stray one is skipped
             if (peek().type == TokenType::Operator && peek().value == ";") advance();
-            else throw std::runtime_error("Expected ';' after statement in while block");
         } else {
             advance();
         }
@@ -285,11 +354,38 @@ std::unique_ptr<ASTNode> Parser::parseWhile() {
     return whileNode;
 }
 
+// { statements } after a loop header
+std::vector<std::unique_ptr<ASTNode>> Parser::parseBlock(const std::string& what) {
+    if (peek().type != TokenType::LBrace) throw std::runtime_error("Expected '{' after " + what + " loop header");
+    advance(); // consume '{'
+    std::vector<std::unique_ptr<ASTNode>> body;
+    while (!isAtEnd() && peek().type != TokenType::RBrace) {
+        auto stmt = parseStatement();
+        if (stmt) {
+            body.push_back(std::move(stmt));
+            // Statements that end in ';' consume it themselves; a stray one is skipped
+            if (peek().type == TokenType::Operator && peek().value == ";") advance();
+        } else {
+            advance();
+        }
+    }
+    if (peek().type != TokenType::RBrace) throw std::runtime_error("Expected '}' after " + what + " block");
+    advance(); // consume '}'
+    return body;
+}
+
 std::unique_ptr<ASTNode> Parser::parseFor() {
-    advance(); // consume 'for'
+    bool parallel = peek().value == "parfor";
+    advance(); // consume 'for' / 'parfor'
     if (peek().type != TokenType::Identifier) throw std::runtime_error("Expected loop variable after 'for'");
     std::string varName = peek().value;
     advance(); // consume variable name
+    if (!parallel && peek().type == TokenType::Keyword && peek().value == "in") {
+        advance(); // consume 'in'
+        auto forIn = std::make_unique<ForInNode>(varName, parseExpression());
+        forIn->body = parseBlock("for");
+        return forIn;
+    }
     if (peek().type != TokenType::Assign) throw std::runtime_error("Expected '=' after loop variable");
     advance(); // consume '='
     auto startExpr = parseExpression();
@@ -301,21 +397,7 @@ std::unique_ptr<ASTNode> Parser::parseFor() {
         advance(); // consume 'step'
         stepExpr = parseExpression();
     }
-    if (peek().type != TokenType::LBrace) throw std::runtime_error("Expected '{' after for loop header");
-    advance(); // consume '{'
-    std::vector<std::unique_ptr<ASTNode>> body;
-    while (!isAtEnd() && peek().type != TokenType::RBrace) {
-        auto stmt = parseStatement();
-        if (stmt) {
-            body.push_back(std::move(stmt));
-            if (peek().type == TokenType::Operator && peek().value == ";") advance();
-            else throw std::runtime_error("Expected ';' after statement in for block");
-        } else {
-            advance();
-        }
-    }
-    if (peek().type != TokenType::RBrace) throw std::runtime_error("Expected '}' after for block");
-    advance(); // consume '}'
+    auto body = parseBlock("for");
     auto forNode = std::make_unique<ForNode>(nullptr, nullptr, nullptr);
     // We'll use init as the variable name, condition as start, increment as end, and step as step
     // Store info in a custom way for this simple for loop
@@ -323,6 +405,7 @@ std::unique_ptr<ASTNode> Parser::parseFor() {
     forNode->condition = std::move(startExpr);
     forNode->increment = std::move(endExpr);
     forNode->body = std::move(body);
+    forNode->parallel = parallel;
     if (stepExpr) {
         // Use step as a special case: attach as a NumberNode to the increment field (not ideal, but works for now)
         forNode->increment = std::make_unique<BinaryExprNode>(
@@ -380,5 +463,98 @@ std::unique_ptr<ASTNode> Parser::parseReturn() {
     return std::make_unique<ReturnNode>(std::move(value));
 }
 
-// Stub methods
-std::unique_ptr<ASTNode> Parser::parseSwitch() { return nullptr; } 
\ No newline at end of file
+std::unique_ptr<ASTNode> Parser::parseSwitch() {
+    advance(); // consume 'switch'
+    if (peek().type != TokenType::LParen) throw std::runtime_error("Expected '(' after 'switch'");
+    advance(); // consume '('
+    auto switchNode = std::make_unique<SwitchNode>(parseExpression());
+    if (peek().type != TokenType::RParen) throw std::runtime_error("Expected ')' after switch value");
+    advance(); // consume ')'
+    if (peek().type != TokenType::LBrace) throw std::runtime_error("Expected '{' after switch value");
+    advance(); // consume '{'
+
+    std::unordered_set<double> numbers;
+    std::unordered_set<std::string> texts;
+    // A number (optionally negative) or a string literal, not seen before in this switch
+    auto label = [&]() -> std::unique_ptr<ExprNode> {
+        bool negative = peek().type == TokenType::Operator && peek().value == "-";
+        if (negative) advance();
+        const Token& token = peek();
+        if (token.type == TokenType::String && !negative) {
+            if (!texts.insert(token.value).second) throw std::runtime_error("Duplicate case label \"" + token.value + "\"");
+            advance();
+            return std::make_unique<StringNode>(token.value);
+        }
+        if (token.type != TokenType::Number && token.type != TokenType::Decimal) {
+            throw std::runtime_error("Expected a number or string literal after 'case'");
+        }
+        std::string value = (negative ? "-" : "") + token.value;
+        if (!numbers.insert(std::stod(value)).second) throw std::runtime_error("Duplicate case label " + value);
+        advance();
+        return std::make_unique<NumberNode>(value);
+    };
+
+    bool seenDefault = false;
+    std::vector<std::unique_ptr<ASTNode>>* body = nullptr; // statements go to the last label
+    while (!isAtEnd() && peek().type != TokenType::RBrace) {
+        if (peek().type == TokenType::Keyword && peek().value == "case") {
+            advance(); // consume 'case'
+            SwitchNode::Case branch;
+            while (true) {
+                branch.labels.push_back(label());
+                if (peek().type == TokenType::Comma) advance();
+                else break;
+            }
+            if (peek().type != TokenType::Colon) throw std::runtime_error("Expected ':' after case label");
+            advance(); // consume ':'
+            switchNode->cases.push_back(std::move(branch));
+            body = &switchNode->cases.back().body;
+        } else if (peek().type == TokenType::Keyword && peek().value == "default") {
+            if (seenDefault) throw std::runtime_error("Duplicate 'default' in switch");
+            seenDefault = true;
+            advance(); // consume 'default'
+            if (peek().type != TokenType::Colon) throw std::runtime_error("Expected ':' after 'default'");
+            advance(); // consume ':'
+            body = &switchNode->defaultBody;
+        } else {
+            if (!body) throw std::runtime_error("Expected 'case' or 'default' in switch");
+            auto stmt = parseStatement();
+            if (stmt) body->push_back(std::move(stmt));
+            else advance();
+        }
+    }
+    if (peek().type != TokenType::RBrace) throw std::runtime_error("Expected '}' after switch cases");
+    advance(); // consume '}'
+    switchNode->buildDispatch();
+    return switchNode;
+} 
+
+// Called by parseSwitch and by the .zenc loader once a switch has all its cases
+void SwitchNode::buildDispatch() {
+    table.clear();
+    numberCases.clear();
+    textCases.clear();
+    bool integers = true;
+    double lo = 0, hi = 0;
+    for (size_t c = 0; c < cases.size(); ++c) {
+        for (const auto& label : cases[c].labels) {
+            if (auto text = dynamic_cast<const StringNode*>(label.get())) {
+                textCases.emplace(text->value, static_cast<int>(c));
+                continue;
+            }
+            double v = std::stod(static_cast<const NumberNode*>(label.get())->value);
+            integers = integers && v == std::floor(v) && std::fabs(v) < 9007199254740992.0;
+            lo = numberCases.empty() ? v : std::min(lo, v);
+            hi = numberCases.empty() ? v : std::max(hi, v);
+            numberCases.emplace(v, static_cast<int>(c));
+        }
+    }
+    // A table at most four times as long as the label count (or 16 slots) beats hashing
+    if (numberCases.empty() || !integers) return;
+    double span = hi - lo + 1;
+    if (span > std::max<double>(16, 4.0 * numberCases.size())) return;
+    tableBase = lo;
+    table.assign(static_cast<size_t>(span), -1);
+    for (const auto& [v, c] : numberCases) table[static_cast<size_t>(v - lo)] = c;
+    numberCases.clear();
+}
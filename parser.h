@@ -3,6 +3,13 @@
 #include "ast.h"
 #include <vector>
 #include <memory>
+#include <stdexcept>
+
+// Syntax error at a byte offset of the parsed source (see LineIndex)
+struct ParseError : std::runtime_error {
+    size_t offset;
+    ParseError(const std::string& message, size_t offset) : std::runtime_error(message), offset(offset) {}
+};
 
 class Parser {
 public:
@@ -16,12 +23,15 @@ private:
     bool match(int type);
     bool isAtEnd() const;
     // Parsing methods
+    // Parses one statement and records where it starts
     std::unique_ptr<ASTNode> parseStatement();
+    std::unique_ptr<ASTNode> parseStatementKind();
     std::unique_ptr<ASTNode> parseVarDecl();
     std::unique_ptr<ASTNode> parsePrint();
     std::unique_ptr<ASTNode> parseIf();
     std::unique_ptr<ASTNode> parseWhile();
     std::unique_ptr<ASTNode> parseFor();
+    std::vector<std::unique_ptr<ASTNode>> parseBlock(const std::string& what);
     std::unique_ptr<ASTNode> parseSwitch();
     std::unique_ptr<ExprNode> parseExpression();
     std::unique_ptr<ExprNode> parsePrimary();
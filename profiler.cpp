@@ -0,0 +1,255 @@
+#include "profiler.h"
+#include "lexer.h"
+#include "program.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/time.h>
+#define ZEN_HAVE_SIGPROF 1
+#endif
+
+namespace profiler {
+
+std::atomic<bool> enabled{false};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// CPU time between stack samples
+constexpr long SAMPLE_INTERVAL_US = 1000;
+// Lines listed in the report, hottest first
+constexpr size_t REPORT_LINES = 20;
+
+// Timer ticks not yet taken as samples. The signal handler only counts; the next
+// statement executed on any profiled thread records its stack with that weight, so
+// nothing but an atomic is touched from signal context.
+std::atomic<uint64_t> pendingSamples{0};
+
+struct FunctionStats {
+    uint64_t calls = 0;
+    double inclusiveMs = 0;
+    double exclusiveMs = 0;
+    int active = 0; // activations on this thread, so a recursive function is timed once
+};
+
+struct StatementStats {
+    const FunctionNode* owner = nullptr; // function whose body holds it; nullptr at top level
+    uint64_t hits = 0;
+};
+
+using SampleKey = std::vector<const FunctionNode*>;
+
+struct ThreadData {
+    std::unordered_map<const FunctionNode*, FunctionStats> functions;
+    std::unordered_map<const ASTNode*, StatementStats> statements;
+    std::map<SampleKey, uint64_t> samples;
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadData>> registry; // outlives the threads that wrote it
+
+ThreadData& local() {
+    thread_local std::shared_ptr<ThreadData> data = [] {
+        auto d = std::make_shared<ThreadData>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(d);
+        return d;
+    }();
+    return *data;
+}
+
+#ifdef ZEN_HAVE_SIGPROF
+void onTick(int) {
+    pendingSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void setTimer(long us) {
+    itimerval timer{};
+    timer.it_interval.tv_usec = us;
+    timer.it_value.tv_usec = us;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+#endif
+
+// A source file and its line table, for turning statement offsets into lines
+struct SourceFile {
+    std::string path;
+    std::string text;
+    std::unique_ptr<LineIndex> lines;
+
+    int line(size_t offset) const { return lines->locate(offset).line; }
+    // The line holding offset, without its indentation
+    std::string lineText(size_t offset) const {
+        size_t begin = text.rfind('\n', offset == 0 ? 0 : offset - 1);
+        begin = begin == std::string::npos || offset == 0 ? 0 : begin + 1;
+        size_t end = text.find('\n', offset);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(begin, end - begin);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return line;
+    }
+};
+
+} // namespace
+
+void start() {
+    enabled = true;
+#ifdef ZEN_HAVE_SIGPROF
+    struct sigaction action{};
+    action.sa_handler = onTick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+    setTimer(SAMPLE_INTERVAL_US);
+#endif
+}
+
+void stop() {
+#ifdef ZEN_HAVE_SIGPROF
+    setTimer(0);
+#endif
+    enabled = false;
+}
+
+void enter(Stack& stack, const FunctionNode* func) {
+    auto& stats = local().functions[func];
+    ++stats.calls;
+    ++stats.active;
+    stack.push_back({func, Clock::now()});
+}
+
+void leave(Stack& stack) {
+    Frame frame = stack.back();
+    stack.pop_back();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - frame.start).count();
+    auto& stats = local().functions[frame.func];
+    stats.exclusiveMs += ms - frame.childMs;
+    if (--stats.active == 0) stats.inclusiveMs += ms;
+    if (!stack.empty()) stack.back().childMs += ms;
+}
+
+void statement(const Stack& stack, const ASTNode* node) {
+    auto& data = local();
+    auto& stats = data.statements[node];
+    if (stats.hits++ == 0) stats.owner = stack.empty() ? nullptr : stack.back().func;
+    if (pendingSamples.load(std::memory_order_relaxed) == 0) return;
+    uint64_t weight = pendingSamples.exchange(0, std::memory_order_relaxed);
+    if (weight == 0) return;
+    SampleKey key;
+    key.reserve(stack.size());
+    for (const auto& frame : stack) key.push_back(frame.func);
+    data.samples[key] += weight;
+}
+
+void report(const Program& program, const std::string& scriptPath, std::ostream& summary, std::ostream& folded) {
+    std::unordered_map<const FunctionNode*, FunctionStats> functions;
+    std::unordered_map<const ASTNode*, StatementStats> statements;
+    std::map<SampleKey, uint64_t> samples;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& data : registry) {
+            for (const auto& [func, s] : data->functions) {
+                auto& total = functions[func];
+                total.calls += s.calls;
+                total.inclusiveMs += s.inclusiveMs;
+                total.exclusiveMs += s.exclusiveMs;
+            }
+            for (const auto& [node, s] : data->statements) {
+                auto& total = statements[node];
+                total.owner = s.owner;
+                total.hits += s.hits;
+            }
+            for (const auto& [key, n] : data->samples) samples[key] += n;
+        }
+    }
+
+    // Statements of the script's own functions and top-level code are in the script; the
+    // rest belong to whichever imported module parsed their function
+    std::map<std::string, SourceFile> files;
+    auto load = [&](const std::string& path, const std::string* text) -> const SourceFile& {
+        auto it = files.find(path);
+        if (it != files.end()) return it->second;
+        SourceFile& file = files[path];
+        file.path = path;
+        if (text) {
+            file.text = *text;
+        } else {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            file.text = buffer.str();
+        }
+        file.lines = std::make_unique<LineIndex>(file.text);
+        return file;
+    };
+    auto sourceOf = [&](const FunctionNode* func) -> const SourceFile& {
+        auto own = func ? program.functions.find(func->name) : program.functions.end();
+        if (func && (own == program.functions.end() || own->second != func)) {
+            for (const auto& module : program.modules) {
+                if (module->find(func->name) != func) continue;
+                return load(module->path().empty() ? "<" + module->name() + ">" : module->path(), &module->text());
+            }
+        }
+        return load(scriptPath, nullptr);
+    };
+    // File name and line of a node, ordered by path and then line number
+    using Location = std::pair<std::string, int>;
+    auto locate = [&](const ASTNode* node, const FunctionNode* owner) -> Location {
+        const SourceFile& file = sourceOf(owner);
+        return {std::filesystem::path(file.path).filename().string(), file.line(node->offset)};
+    };
+    auto where = [](const Location& at) { return at.first + ":" + std::to_string(at.second); };
+
+    std::vector<std::pair<const FunctionNode*, FunctionStats>> byTime(functions.begin(), functions.end());
+    std::sort(byTime.begin(), byTime.end(), [](const auto& a, const auto& b) { return a.second.exclusiveMs > b.second.exclusiveMs; });
+    summary << "profile: functions by exclusive time\n";
+    summary << std::setw(10) << "calls" << std::setw(12) << "incl ms" << std::setw(12) << "excl ms" << "  function\n";
+    summary << std::fixed << std::setprecision(2);
+    for (const auto& [func, s] : byTime) {
+        summary << std::setw(10) << s.calls << std::setw(12) << s.inclusiveMs << std::setw(12) << s.exclusiveMs
+                << "  " << func->name << " (" << where(locate(func, func)) << ")\n";
+    }
+
+    // Statements on the same line are counted together
+    struct LineHits {
+        uint64_t hits = 0;
+        std::string text;
+    };
+    std::map<Location, LineHits> lines;
+    for (const auto& [node, s] : statements) {
+        auto& entry = lines[locate(node, s.owner)];
+        entry.hits += s.hits;
+        if (entry.text.empty()) entry.text = sourceOf(s.owner).lineText(node->offset);
+    }
+    std::vector<std::pair<Location, LineHits>> byHits(lines.begin(), lines.end());
+    std::stable_sort(byHits.begin(), byHits.end(), [](const auto& a, const auto& b) { return a.second.hits > b.second.hits; });
+    if (byHits.size() > REPORT_LINES) byHits.resize(REPORT_LINES);
+    summary << "profile: hottest lines\n";
+    summary << std::setw(10) << "hits" << "  line\n";
+    for (const auto& [at, entry] : byHits) {
+        summary << std::setw(10) << entry.hits << "  " << where(at) << "  " << entry.text << "\n";
+    }
+
+    uint64_t total = 0;
+    std::string root = std::filesystem::path(scriptPath).filename().string();
+    for (const auto& [key, n] : samples) {
+        folded << root;
+        for (const FunctionNode* func : key) folded << ";" << func->name;
+        folded << " " << n << "\n";
+        total += n;
+    }
+    summary << "profile: " << total << " stack samples\n";
+}
+
+} // namespace profiler
@@ -0,0 +1,42 @@
+#pragma once
+#include "ast.h"
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Program;
+
+// Script-level profiler behind `zen --profile`. While it is on, every interpreter in the
+// process counts calls and time per function and executions per statement, and a CPU
+// timer asks for a sample of the script call stack about once a millisecond. Counters are
+// kept per thread and merged when the report is written.
+namespace profiler {
+
+// A call in progress. Each interpreter (and each task) keeps its own stack of these.
+struct Frame {
+    const FunctionNode* func;
+    std::chrono::steady_clock::time_point start;
+    double childMs = 0;
+};
+using Stack = std::vector<Frame>;
+
+extern std::atomic<bool> enabled;
+
+inline bool on() { return enabled.load(std::memory_order_relaxed); }
+// Turns profiling on and starts the SIGPROF timer. Call before any script runs.
+void start();
+// Stops the timer; what was recorded stays until the report is written
+void stop();
+
+void enter(Stack& stack, const FunctionNode* func);
+void leave(Stack& stack);
+// Counts one execution of a statement, and takes a stack sample if one is due
+void statement(const Stack& stack, const ASTNode* node);
+
+// Writes the function and line tables to summary and the sampled stacks to folded, one
+// "script;f;g count" line per distinct stack, the input format of flamegraph tools
+void report(const Program& program, const std::string& scriptPath, std::ostream& summary, std::ostream& folded);
+
+} // namespace profiler
@@ -0,0 +1,109 @@
+#include "program.h"
+#include "lexer.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Below this a source parses faster on one thread than it can be split and merged
+constexpr size_t PARALLEL_PARSE_MIN_BYTES = 256 * 1024;
+constexpr size_t PARSE_CHUNK_MIN_BYTES = 64 * 1024;
+
+// Parses source[begin, end). Offsets in the AST and in syntax errors are in the whole source.
+std::vector<std::unique_ptr<ASTNode>> parseText(const std::string& source, size_t begin, size_t end) {
+    try {
+        Lexer lexer(begin == 0 && end == source.size() ? source : source.substr(begin, end - begin));
+        auto tokens = lexer.tokenize();
+        for (auto& token : tokens) token.offset += begin;
+        Parser parser(tokens);
+        return parser.parse();
+    } catch (const ParseError& e) {
+        SourceLocation at = LineIndex(source).locate(e.offset);
+        throw std::runtime_error("line " + std::to_string(at.line) + ", column " + std::to_string(at.column) + ": " + e.what());
+    }
+}
+
+// Large sources are cut just before top-level funcs into chunks of roughly equal size,
+// which are lexed and parsed on the thread pool and concatenated in source order.
+std::vector<std::unique_ptr<ASTNode>> parseSource(const std::string& source) {
+    auto& pool = ThreadPool::instance();
+    if (source.size() < PARALLEL_PARSE_MIN_BYTES || pool.size() == 1) return parseText(source, 0, source.size());
+
+    size_t target = std::max(PARSE_CHUNK_MIN_BYTES, source.size() / (pool.size() * 4));
+    std::vector<size_t> cuts{0};
+    for (const auto& func : findTopLevelFuncs(source)) {
+        if (func.begin - cuts.back() >= target) cuts.push_back(func.begin);
+    }
+    cuts.push_back(source.size());
+    size_t chunks = cuts.size() - 1;
+    if (chunks == 1) return parseText(source, 0, source.size());
+
+    std::vector<std::vector<std::unique_ptr<ASTNode>>> parts(chunks);
+    std::vector<std::exception_ptr> errors(chunks);
+    pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            try {
+                parts[c] = parseText(source, cuts[c], cuts[c + 1]);
+            } catch (...) {
+                errors[c] = std::current_exception();
+            }
+        }
+    });
+    // Report the error a sequential parse would have hit first
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    std::vector<std::unique_ptr<ASTNode>> nodes;
+    for (auto& part : parts) {
+        for (auto& node : part) nodes.push_back(std::move(node));
+    }
+    return nodes;
+}
+
+} // namespace
+
+Program::Program(std::vector<std::unique_ptr<ASTNode>> nodes, const std::string& baseDir) : ast(std::move(nodes)) {
+    std::vector<std::pair<std::string, std::string>> pending; // module name, directory it is imported from
+    for (const auto& node : ast) {
+        if (auto func = dynamic_cast<const FunctionNode*>(node.get())) {
+            functions[func->name] = func;
+        } else if (auto use = dynamic_cast<const UseNode*>(node.get())) {
+            pending.emplace_back(use->module, baseDir);
+        }
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+        auto module = ModuleCache::instance().load(pending[i].first, pending[i].second);
+        bool seen = false;
+        for (const auto& m : modules) seen = seen || m == module;
+        if (seen) continue;
+        modules.push_back(module);
+        for (const auto& name : module->uses()) pending.emplace_back(name, module->dir());
+    }
+}
+
+const FunctionNode* Program::findFunction(const std::string& name) const {
+    auto it = functions.find(name);
+    if (it != functions.end()) return it->second;
+    for (const auto& module : modules) {
+        if (const FunctionNode* func = module->find(name)) return func;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const Program> compile(const std::string& source, const std::string& baseDir) {
+    return std::make_shared<const Program>(parseSource(source), baseDir);
+}
+
+std::shared_ptr<const Program> compileFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("Could not open file: " + path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return compile(buffer.str(), std::filesystem::path(path).parent_path().string());
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "ast.h"
+#include "module.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A parsed script: the AST and its functions, resolved once. Nothing in a Program is
+// written after compile(), so any number of threads can run it at the same time, each
+// in its own Interpreter.
+struct Program {
+    std::vector<std::unique_ptr<ASTNode>> ast;
+    std::unordered_map<std::string, const FunctionNode*> functions;
+    // Every module imported by the script, directly or through other modules, in import order
+    std::vector<std::shared_ptr<const Module>> modules;
+    // Resolves the script's #use lines against baseDir (the script's directory)
+    Program(std::vector<std::unique_ptr<ASTNode>> nodes, const std::string& baseDir);
+    // The script's own functions shadow imported ones; earlier imports shadow later ones
+    const FunctionNode* findFunction(const std::string& name) const;
+};
+
+// Lexes and parses source; throws std::runtime_error on syntax errors. Large sources are
+// split at top-level funcs and parsed in parallel. Modules are searched for relative to
+// baseDir first.
+std::shared_ptr<const Program> compile(const std::string& source, const std::string& baseDir = ".");
+std::shared_ptr<const Program> compileFile(const std::string& path);
@@ -0,0 +1,493 @@
+#include "readers.h"
+#include "mapped_file.h"
+#include "scan.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+// Reads the JSON number -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? at the start of
+// [p, end) into value and returns where it ends. Returns null and names the problem when
+// there is none, or when it is too large for a double; too small rounds towards zero.
+// std::from_chars alone would also take inf, nan and friends.
+const char* scanNumber(const char* p, const char* end, double& value, const char*& problem) {
+    auto digits = [&](const char* at) {
+        while (at < end && *at >= '0' && *at <= '9') ++at;
+        return at;
+    };
+    const char* stop = p;
+    if (stop < end && *stop == '-') ++stop;
+    if (stop >= end || *stop < '0' || *stop > '9') {
+        problem = "unexpected character";
+        return nullptr;
+    }
+    stop = *stop == '0' ? stop + 1 : digits(stop);
+    if (stop < end && *stop == '.') {
+        const char* fraction = digits(stop + 1);
+        if (fraction == stop + 1) {
+            problem = "expected a digit after '.'";
+            return nullptr;
+        }
+        stop = fraction;
+    }
+    if (stop < end && (*stop == 'e' || *stop == 'E')) {
+        const char* at = stop + 1;
+        if (at < end && (*at == '+' || *at == '-')) ++at;
+        const char* exponent = digits(at);
+        if (exponent == at) {
+            problem = "expected a digit in the exponent";
+            return nullptr;
+        }
+        stop = exponent;
+    }
+    value = 0;
+    auto result = std::from_chars(p, stop, value);
+    if (result.ec == std::errc::result_out_of_range) {
+        value = std::strtod(std::string(p, stop).c_str(), nullptr);
+        if (std::isinf(value)) {
+            problem = "number out of range";
+            return nullptr;
+        }
+    } else if (result.ec != std::errc() || result.ptr != stop) {
+        problem = "malformed number";
+        return nullptr;
+    }
+    return stop;
+}
+
+// Whole-field number parse, JSON numbers with an optional leading '+'; false if anything
+// but a number is in text, so fields such as "NaN" or "Infinity" stay text
+bool parseNumber(std::string_view text, double& out) {
+    if (text.empty()) return false;
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    if (begin != end && *begin == '+') {
+        ++begin;
+        if (begin != end && *begin == '-') return false;
+    }
+    const char* problem;
+    return scanNumber(begin, end, out, problem) == end;
+}
+
+class LinesSequence : public Sequence {
+public:
+    explicit LinesSequence(std::shared_ptr<const MappedFile> file) : file(std::move(file)) {}
+    void forEach(Interpreter&, const std::function<bool(Value)>& f) const override {
+        forEachLine(file, [&](const TextView& line) { return f(line); });
+    }
+    std::string describe() const override { return "lines " + file->path(); }
+private:
+    std::shared_ptr<const MappedFile> file;
+};
+
+// One CSV column being filled: contiguous numbers until the first field that is not one
+struct CsvColumn {
+    std::vector<double> numbers;
+    Pack values;
+    bool numeric = true;
+
+    void add(Value text, std::string_view raw) {
+        double number;
+        bool isNumber = parseNumber(raw, number);
+        if (numeric) {
+            if (isNumber || raw.empty()) {
+                numbers.push_back(isNumber ? number : std::nan(""));
+                return;
+            }
+            numeric = false;
+            values.reserve(numbers.size() + 1);
+            for (double x : numbers) values.push_back(std::make_shared<Value>(x));
+            numbers.clear();
+        }
+        values.push_back(isNumber ? std::make_shared<Value>(number) : std::make_shared<Value>(std::move(text)));
+    }
+    void padTo(size_t rows) {
+        while ((numeric ? numbers.size() : values.size()) < rows) add(std::string(), std::string_view());
+    }
+    Value finish() {
+        if (numeric) return makeNumPack(std::move(numbers));
+        return std::move(values);
+    }
+};
+
+class CsvReader {
+public:
+    explicit CsvReader(std::shared_ptr<const MappedFile> file)
+        : file(std::move(file)), s(this->file->data()), n(this->file->size()) {
+        this->file->adviseSequential();
+        std::vector<Value> names;
+        readRow(names);
+        if (names.empty()) throw std::runtime_error("read_csv: " + this->file->path() + " has no header row");
+        for (const auto& name : names) header.emplace_back(textOf(name));
+    }
+
+    // Reads up to maxRows rows into a map of columns; false if there were none left
+    bool next(size_t maxRows, Map& out) {
+        std::vector<CsvColumn> columns(header.size());
+        std::vector<Value> row;
+        size_t rows = 0;
+        while (rows < maxRows && pos < n) {
+            std::vector<std::string_view> raw;
+            if (!readRow(row, &raw)) continue; // blank line
+            if (row.size() > header.size()) {
+                throw std::runtime_error("read_csv: row " + std::to_string(rowNumber) + " has more fields than the header");
+            }
+            for (size_t c = 0; c < row.size(); ++c) columns[c].add(std::move(row[c]), raw[c]);
+            ++rows;
+            for (size_t c = row.size(); c < columns.size(); ++c) columns[c].padTo(rows);
+        }
+        out = makeMap();
+        for (size_t c = 0; c < header.size(); ++c) out.set(header[c], columns[c].finish());
+        return rows > 0;
+    }
+
+    size_t offset() const { return pos; }
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    const char* s;
+    size_t n;
+    size_t pos = 0;
+    size_t rowNumber = 0;
+    std::vector<std::string> header;
+
+    // Reads one line of fields into row (and their unescaped text into raw); false for a blank line
+    bool readRow(std::vector<Value>& row, std::vector<std::string_view>* raw = nullptr) {
+        row.clear();
+        ++rowNumber;
+        if (pos < n && (s[pos] == '\n' || s[pos] == '\r')) {
+            pos = skipLineEnd(pos);
+            return false;
+        }
+        while (pos < n) {
+            if (s[pos] == '"') {
+                readQuoted(row, raw);
+            } else {
+                size_t stop = scan::findAny(s, pos, n, ',', '\n', '\r');
+                row.push_back(TextView{file, s + pos, stop - pos});
+                if (raw) raw->emplace_back(s + pos, stop - pos);
+                pos = stop;
+            }
+            if (pos >= n) break;
+            if (s[pos] == ',') {
+                ++pos;
+                if (pos >= n) {
+                    row.push_back(std::string()); // trailing empty field
+                    if (raw) raw->emplace_back();
+                }
+                continue;
+            }
+            pos = skipLineEnd(pos);
+            break;
+        }
+        return true;
+    }
+
+    // "..." with "" standing for a quote. Contents without doubled quotes stay a view.
+    void readQuoted(std::vector<Value>& row, std::vector<std::string_view>* raw) {
+        size_t begin = ++pos;
+        std::string unescaped;
+        bool escaped = false;
+        while (true) {
+            size_t quote = scan::find(s, pos, n, '"');
+            if (quote >= n) throw std::runtime_error("read_csv: unterminated quoted field in row " + std::to_string(rowNumber));
+            if (quote + 1 < n && s[quote + 1] == '"') {
+                unescaped.append(s + pos, quote + 1 - pos);
+                pos = quote + 2;
+                escaped = true;
+                continue;
+            }
+            if (escaped) {
+                unescaped.append(s + pos, quote - pos);
+                pos = quote + 1;
+                break;
+            }
+            pos = quote + 1;
+            row.push_back(TextView{file, s + begin, quote - begin});
+            if (raw) raw->emplace_back(s + begin, quote - begin);
+            return;
+        }
+        // The raw view only feeds the number check, and a field with quotes in it is never a number
+        if (raw) raw->emplace_back("\"", 1);
+        row.push_back(std::move(unescaped));
+    }
+
+    size_t skipLineEnd(size_t at) {
+        if (at < n && s[at] == '\r') ++at;
+        if (at < n && s[at] == '\n') ++at;
+        return at;
+    }
+};
+
+class CsvChunks : public Sequence {
+public:
+    CsvChunks(std::shared_ptr<const MappedFile> file, size_t rows) : file(std::move(file)), rows(rows) {}
+    void forEach(Interpreter&, const std::function<bool(Value)>& f) const override {
+        CsvReader reader(file);
+        Map chunk;
+        while (reader.next(rows, chunk)) {
+            if (!f(chunk)) return;
+            // Later chunks never look back; pages still viewed by text cells are re-read on demand
+            file->releaseBefore(reader.offset());
+        }
+    }
+    std::string describe() const override { return "csv chunks " + file->path(); }
+private:
+    std::shared_ptr<const MappedFile> file;
+    size_t rows;
+};
+
+class JsonParser {
+public:
+    JsonParser(std::string_view text, std::shared_ptr<const MappedFile> file)
+        : s(text.data()), n(text.size()), file(std::move(file)) {}
+
+    Value document() {
+        Value v = value(0);
+        skip();
+        if (pos != n) fail("unexpected data after the document");
+        return v;
+    }
+
+private:
+    const char* s;
+    size_t n;
+    size_t pos = 0;
+    std::shared_ptr<const MappedFile> file;
+    static constexpr int MAX_DEPTH = 512;
+
+    [[noreturn]] void fail(const std::string& what) {
+        throw std::runtime_error("JSON: " + what + " at byte " + std::to_string(pos));
+    }
+    void skip() { pos = scan::skipSpace(s, pos, n); }
+    void expect(char c) {
+        skip();
+        if (pos >= n || s[pos] != c) fail(std::string("expected '") + c + "'");
+        ++pos;
+    }
+    bool literal(const char* word) {
+        size_t len = std::char_traits<char>::length(word);
+        if (n - pos < len || std::char_traits<char>::compare(s + pos, word, len) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    Value value(int depth) {
+        if (depth > MAX_DEPTH) fail("nesting too deep");
+        skip();
+        if (pos >= n) fail("unexpected end of input");
+        char c = s[pos];
+        if (c == '{') return object(depth);
+        if (c == '[') return array(depth);
+        if (c == '"') return string(true);
+        if (literal("true")) return 1.0;
+        if (literal("false") || literal("null")) return 0.0;
+        return number();
+    }
+
+    Value object(int depth) {
+        ++pos; // '{'
+        Map map = makeMap();
+        skip();
+        if (pos < n && s[pos] == '}') {
+            ++pos;
+            return map;
+        }
+        while (true) {
+            skip();
+            if (pos >= n || s[pos] != '"') fail("expected a key");
+            Value key = string(false);
+            expect(':');
+            map.set(std::get<std::string>(key), value(depth + 1));
+            skip();
+            if (pos < n && s[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            expect('}');
+            return map;
+        }
+    }
+
+    Value array(int depth) {
+        ++pos; // '['
+        std::vector<Value> items;
+        bool numeric = true;
+        skip();
+        if (pos < n && s[pos] == ']') {
+            ++pos;
+            return makeNumPack({});
+        }
+        while (true) {
+            items.push_back(value(depth + 1));
+            numeric = numeric && std::holds_alternative<double>(items.back());
+            skip();
+            if (pos < n && s[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            expect(']');
+            break;
+        }
+        if (numeric) {
+            std::vector<double> numbers;
+            numbers.reserve(items.size());
+            for (const auto& v : items) numbers.push_back(std::get<double>(v));
+            return makeNumPack(std::move(numbers));
+        }
+        Pack pack;
+        pack.reserve(items.size());
+        for (auto& v : items) pack.push_back(std::make_shared<Value>(std::move(v)));
+        return pack;
+    }
+
+    // A string without escapes is a view into the file when there is one to point into
+    Value string(bool allowView) {
+        size_t begin = ++pos; // '"'
+        size_t stop = scan::findEither(s, pos, n, '"', '\\');
+        if (stop >= n) fail("unterminated string");
+        checkText(begin, stop);
+        if (s[stop] == '"') {
+            pos = stop + 1;
+            if (allowView && file) return TextView{file, s + begin, stop - begin};
+            return std::string(s + begin, stop - begin);
+        }
+        std::string out(s + begin, stop - begin);
+        pos = stop;
+        while (true) {
+            if (pos >= n) fail("unterminated string");
+            if (s[pos] == '"') {
+                ++pos;
+                return out;
+            }
+            if (s[pos] != '\\') {
+                stop = scan::findEither(s, pos, n, '"', '\\');
+                checkText(pos, stop);
+                out.append(s + pos, stop - pos);
+                pos = stop;
+                continue;
+            }
+            if (++pos >= n) fail("unterminated string");
+            char e = s[pos++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': appendCodePoint(out); break;
+                case '"': case '\\': case '/': out += e; break;
+                default: --pos; fail("bad escape");
+            }
+        }
+    }
+
+    // Control characters must be escaped inside a string
+    void checkText(size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            if (static_cast<unsigned char>(s[i]) < 0x20) {
+                pos = i;
+                fail("control character in string");
+            }
+        }
+    }
+
+    unsigned hex4() {
+        if (n - pos < 4) fail("bad \\u escape");
+        unsigned v = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = s[pos++];
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= static_cast<unsigned>(c - '0');
+            else if (c >= 'a' && c <= 'f') v |= static_cast<unsigned>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v |= static_cast<unsigned>(c - 'A' + 10);
+            else fail("bad \\u escape");
+        }
+        return v;
+    }
+
+    // \uXXXX as UTF-8. A surrogate must be a high one followed by a \u low one; alone
+    // it has no UTF-8 encoding.
+    void appendCodePoint(std::string& out) {
+        unsigned cp = hex4();
+        if (cp >= 0xDC00 && cp < 0xE000) fail("unpaired surrogate");
+        if (cp >= 0xD800 && cp < 0xDC00) {
+            if (n - pos < 6 || s[pos] != '\\' || s[pos + 1] != 'u') fail("unpaired surrogate");
+            pos += 2;
+            unsigned low = hex4();
+            if (low < 0xDC00 || low >= 0xE000) fail("unpaired surrogate");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    Value number() {
+        double v;
+        const char* problem;
+        const char* stop = scanNumber(s + pos, s + n, v, problem);
+        if (!stop) fail(problem);
+        pos = static_cast<size_t>(stop - s);
+        return v;
+    }
+};
+
+class JsonLines : public Sequence {
+public:
+    explicit JsonLines(std::shared_ptr<const MappedFile> file) : file(std::move(file)) {}
+    void forEach(Interpreter&, const std::function<bool(Value)>& f) const override {
+        size_t lineNumber = 0;
+        forEachLine(file, [&](const TextView& line) {
+            ++lineNumber;
+            if (scan::skipSpace(line.data, 0, line.size) == line.size) return true;
+            try {
+                return f(JsonParser(line.view(), file).document());
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error(file->path() + " line " + std::to_string(lineNumber) + ": " + e.what());
+            }
+        });
+    }
+    std::string describe() const override { return "json lines " + file->path(); }
+private:
+    std::shared_ptr<const MappedFile> file;
+};
+
+} // namespace
+
+SequencePtr linesOf(std::shared_ptr<const MappedFile> file) {
+    return std::make_shared<LinesSequence>(std::move(file));
+}
+
+Value readCsv(std::shared_ptr<const MappedFile> file) {
+    Map columns;
+    CsvReader(file).next(static_cast<size_t>(-1), columns); // a header alone gives empty columns
+    return columns;
+}
+
+SequencePtr csvChunks(std::shared_ptr<const MappedFile> file, size_t rows) {
+    if (rows == 0) throw std::runtime_error("csv_chunks: rows must be positive");
+    return std::make_shared<CsvChunks>(std::move(file), rows);
+}
+
+Value parseJson(std::string_view text, std::shared_ptr<const MappedFile> file) {
+    return JsonParser(text, std::move(file)).document();
+}
+
+SequencePtr jsonLines(std::shared_ptr<const MappedFile> file) {
+    return std::make_shared<JsonLines>(std::move(file));
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "value.h"
+#include <memory>
+#include <string_view>
+
+// File readers. They work straight on a mapped file: unquoted CSV fields and JSON
+// strings without escapes come back as TextViews into the mapping, and the scans for
+// delimiters, quotes and whitespace use the scan:: SIMD loops.
+
+// lines(path): the file's lines, one TextView each
+SequencePtr linesOf(std::shared_ptr<const MappedFile> file);
+
+// read_csv(path): a map from each header name to its column. A column whose fields are
+// all numbers (or empty, read as nan) becomes a numeric pack; any other column is a pack
+// of its values, numbers and text.
+Value readCsv(std::shared_ptr<const MappedFile> file);
+// csv_chunks(path, rows): the same column maps for successive blocks of at most rows rows
+SequencePtr csvChunks(std::shared_ptr<const MappedFile> file, size_t rows);
+
+// Objects become maps, arrays of numbers numeric packs, other arrays packs, true/false
+// 1/0 and null 0. file, if given, is kept alive by the TextViews into text.
+Value parseJson(std::string_view text, std::shared_ptr<const MappedFile> file = nullptr);
+// json_lines(path): one parsed document per non-blank line (JSON Lines / NDJSON)
+SequencePtr jsonLines(std::shared_ptr<const MappedFile> file);
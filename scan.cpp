@@ -0,0 +1,164 @@
+#include "scan.h"
+#include "simd.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ZEN_SCAN_X86 1
+#define ZEN_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+inline unsigned firstSet(unsigned mask) { return static_cast<unsigned>(__builtin_ctz(mask)); }
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define ZEN_SCAN_X86 1
+#define ZEN_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+inline unsigned firstSet(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+}
+#endif
+
+namespace scan {
+
+namespace {
+
+// Scalar tails and fallback
+
+size_t scalarSkip(const char* s, size_t i, size_t n, uint8_t cls) {
+    while (i < n && is(s[i], cls)) ++i;
+    return i;
+}
+
+size_t scalarFind(const char* s, size_t i, size_t n, char a, char b, char c) {
+    while (i < n && s[i] != a && s[i] != b && s[i] != c) ++i;
+    return i;
+}
+
+struct Scanners {
+    size_t (*skipSpace)(const char*, size_t, size_t);
+    size_t (*skipIdent)(const char*, size_t, size_t);
+    size_t (*find)(const char*, size_t, size_t, char, char, char);
+};
+
+const Scanners scalarScanners = {
+    [](const char* s, size_t i, size_t n) { return scalarSkip(s, i, n, Space); },
+    [](const char* s, size_t i, size_t n) { return scalarSkip(s, i, n, Ident); },
+    scalarFind,
+};
+
+#ifdef ZEN_SCAN_X86
+
+// x in [lo, lo + span] as unsigned bytes: (x - lo) == min(x - lo, span)
+inline __m128i sse2InRange(__m128i x, char lo, char span) {
+    __m128i t = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(span)), t);
+}
+
+inline __m128i sse2Space(__m128i x) {
+    return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), sse2InRange(x, '\t', '\r' - '\t'));
+}
+
+inline __m128i sse2Ident(__m128i x) {
+    __m128i letter = sse2InRange(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z' - 'a');
+    __m128i digit = sse2InRange(x, '0', 9);
+    return _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+}
+
+template <__m128i (*Match)(__m128i)>
+size_t sse2Skip(const char* s, size_t i, size_t n, uint8_t cls) {
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(Match(x))) & 0xFFFFu;
+        if (stop) return i + firstSet(stop);
+    }
+    return scalarSkip(s, i, n, cls);
+}
+
+size_t sse2Find(const char* s, size_t i, size_t n, char a, char b, char c) {
+    __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)), _mm_cmpeq_epi8(x, vc));
+        unsigned hit = static_cast<unsigned>(_mm_movemask_epi8(eq));
+        if (hit) return i + firstSet(hit);
+    }
+    return scalarFind(s, i, n, a, b, c);
+}
+
+const Scanners sse2Scanners = {
+    [](const char* s, size_t i, size_t n) { return sse2Skip<sse2Space>(s, i, n, Space); },
+    [](const char* s, size_t i, size_t n) { return sse2Skip<sse2Ident>(s, i, n, Ident); },
+    sse2Find,
+};
+
+ZEN_TARGET_AVX2 inline __m256i avx2InRange(__m256i x, char lo, char span) {
+    __m256i t = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(span)), t);
+}
+
+ZEN_TARGET_AVX2 inline __m256i avx2Space(__m256i x) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), avx2InRange(x, '\t', '\r' - '\t'));
+}
+
+ZEN_TARGET_AVX2 inline __m256i avx2Ident(__m256i x) {
+    __m256i letter = avx2InRange(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a');
+    __m256i digit = avx2InRange(x, '0', 9);
+    return _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+}
+
+// Short runs are the common case, so the 16-byte step handles what is left under 32
+ZEN_TARGET_AVX2 size_t avx2SkipSpace(const char* s, size_t i, size_t n) {
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(avx2Space(x)));
+        if (stop) return i + firstSet(stop);
+    }
+    return sse2Skip<sse2Space>(s, i, n, Space);
+}
+
+ZEN_TARGET_AVX2 size_t avx2SkipIdent(const char* s, size_t i, size_t n) {
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(avx2Ident(x)));
+        if (stop) return i + firstSet(stop);
+    }
+    return sse2Skip<sse2Ident>(s, i, n, Ident);
+}
+
+ZEN_TARGET_AVX2 size_t avx2Find(const char* s, size_t i, size_t n, char a, char b, char c) {
+    __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c);
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)), _mm256_cmpeq_epi8(x, vc));
+        unsigned hit = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+        if (hit) return i + firstSet(hit);
+    }
+    return sse2Find(s, i, n, a, b, c);
+}
+
+const Scanners avx2Scanners = {avx2SkipSpace, avx2SkipIdent, avx2Find};
+
+#endif // ZEN_SCAN_X86
+
+const Scanners& scanners() {
+    static const Scanners& selected = [] () -> const Scanners& {
+        switch (simd::level()) {
+#ifdef ZEN_SCAN_X86
+            case simd::Level::Avx2: return avx2Scanners;
+            case simd::Level::Sse2: return sse2Scanners;
+#endif
+            default: return scalarScanners;
+        }
+    }();
+    return selected;
+}
+
+} // namespace
+
+size_t skipSpace(const char* s, size_t i, size_t n) { return scanners().skipSpace(s, i, n); }
+size_t skipIdent(const char* s, size_t i, size_t n) { return scanners().skipIdent(s, i, n); }
+size_t find(const char* s, size_t i, size_t n, char c) { return scanners().find(s, i, n, c, c, c); }
+size_t findEither(const char* s, size_t i, size_t n, char a, char b) { return scanners().find(s, i, n, a, b, b); }
+size_t findAny(const char* s, size_t i, size_t n, char a, char b, char c) { return scanners().find(s, i, n, a, b, c); }
+
+} // namespace scan
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Character classes and byte scanning for the lexer. Classes are fixed ASCII sets, not
+// locale-dependent; bytes >= 0x80 belong to none. The scanning loops use the instruction
+// set picked by simd::level() and look at 16 (SSE2) or 32 (AVX2) bytes per step.
+namespace scan {
+
+enum : uint8_t {
+    Space = 1,      // ' ' \t \n \v \f \r
+    IdentStart = 2, // A-Z a-z _
+    Ident = 4,      // A-Z a-z 0-9 _
+    Digit = 8       // 0-9
+};
+
+struct ClassTable {
+    uint8_t bits[256];
+};
+
+constexpr ClassTable makeClassTable() {
+    ClassTable t{};
+    t.bits[static_cast<int>(' ')] = Space;
+    for (int c = '\t'; c <= '\r'; ++c) t.bits[c] = Space;
+    for (int c = 'a'; c <= 'z'; ++c) t.bits[c] = IdentStart | Ident;
+    for (int c = 'A'; c <= 'Z'; ++c) t.bits[c] = IdentStart | Ident;
+    for (int c = '0'; c <= '9'; ++c) t.bits[c] = Ident | Digit;
+    t.bits[static_cast<int>('_')] = IdentStart | Ident;
+    return t;
+}
+
+inline constexpr ClassTable CLASSES = makeClassTable();
+
+inline bool is(char c, uint8_t cls) { return (CLASSES.bits[static_cast<unsigned char>(c)] & cls) != 0; }
+
+// Each returns the index of the first byte in s[i, n) that stops the scan, or n
+size_t skipSpace(const char* s, size_t i, size_t n); // first non-whitespace byte
+size_t skipIdent(const char* s, size_t i, size_t n); // first byte outside [A-Za-z0-9_]
+size_t find(const char* s, size_t i, size_t n, char c);
+size_t findEither(const char* s, size_t i, size_t n, char a, char b);
+size_t findAny(const char* s, size_t i, size_t n, char a, char b, char c);
+
+} // namespace scan
@@ -0,0 +1,353 @@
+#include "scheduler.h"
+#include "interpreter.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+#ifdef ZEN_HAVE_FIBERS
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+// The task stack is reserved, not committed: only the pages the deepest task touches
+// are ever backed
+constexpr size_t STACK_SIZE = 8 * 1024 * 1024;
+constexpr size_t GUARD_SIZE = 4096;
+
+void closeAndReap(int fd, pid_t pid, bool kill) {
+    close(fd);
+    if (kill) ::kill(-pid, SIGKILL);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+}
+
+// Lowest address a switched-out task still uses, from the stack pointer swapcontext
+// saved; null where that is not known, and the whole stack is kept
+const char* stackPointerOf(const ucontext_t& context) {
+#if defined(__x86_64__)
+    return reinterpret_cast<const char*>(context.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+    return reinterpret_cast<const char*>(context.uc_mcontext.sp);
+#else
+    return nullptr;
+#endif
+}
+}
+#endif
+
+Scheduler::Scheduler(Interpreter& interp) : interp(interp) {}
+
+Scheduler::~Scheduler() {
+#ifdef ZEN_HAVE_FIBERS
+    // Tasks still suspended here are abandoned mid-call; their saved stacks go with them,
+    // and the commands they were reading from are stopped
+    for (const auto& [fd, pid] : commands) closeAndReap(fd, pid, true);
+    if (stack) munmap(stack, STACK_SIZE + GUARD_SIZE);
+    if (epollFd >= 0) close(epollFd);
+#endif
+}
+
+std::shared_ptr<Task> Scheduler::spawn(const FunctionNode* func, std::vector<Value> args) {
+    auto task = std::make_shared<Task>();
+    task->func = func;
+    task->args = std::move(args);
+    live[task.get()] = task;
+    ready.push_back(task.get());
+    return task;
+}
+
+Value Scheduler::await(const std::shared_ptr<Task>& task) {
+    if (task.get() == current) throw std::runtime_error("await: a task cannot await itself");
+    task->awaited = true;
+    if (task->state != Task::State::Done) {
+        if (current) {
+            task->waiters.push_back(current);
+            suspendCurrent();
+        } else {
+            runUntil([&] { return task->state == Task::State::Done; });
+        }
+    }
+    if (task->error) std::rethrow_exception(task->error);
+    return task->result;
+}
+
+void Scheduler::drain() {
+    runUntil([&] { return live.empty(); });
+    for (const auto& task : failed) {
+        if (!task->awaited) std::rethrow_exception(task->error);
+    }
+    failed.clear();
+}
+
+void Scheduler::wake(Task* task) {
+    if (task) ready.push_back(task);
+    else rootWoken = true;
+}
+
+void Scheduler::finish(Task* task) {
+    task->state = Task::State::Done;
+    for (Task* waiter : task->waiters) wake(waiter);
+    task->waiters.clear();
+    task->args.clear();
+    if (task->error) failed.push_back(live[task]);
+}
+
+void Scheduler::swapState(Task* task) {
+    std::swap(interp.variables, task->variables);
+    std::swap(interp.inherited, task->inherited);
+    std::swap(interp.callStack, task->callStack);
+    std::swap(interp.hasReturn, task->hasReturn);
+    std::swap(interp.returnValue, task->returnValue);
+    std::swap(interp.profileStack, task->profileStack);
+    std::swap(interp.sharedTargets, task->sharedTargets);
+    std::swap(interp.callDepth, task->callDepth);
+}
+
+#ifdef ZEN_HAVE_FIBERS
+
+char* Scheduler::stackTop() const {
+    return stack + GUARD_SIZE + STACK_SIZE;
+}
+
+void Scheduler::trampoline(unsigned lo, unsigned hi) {
+    auto* self = reinterpret_cast<Scheduler*>((static_cast<uintptr_t>(hi) << 32) | lo);
+    Task* task = self->current;
+    try {
+        task->result = self->interp.callFunction(task->func, task->args);
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    self->finish(task);
+    // Returning continues at uc_link, the loop that resumed this task
+}
+
+void Scheduler::resume(Task* task) {
+    if (!stack) {
+        void* mem = mmap(nullptr, STACK_SIZE + GUARD_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (mem == MAP_FAILED) throw std::runtime_error("spawn: cannot allocate task stack");
+        // Lowest page traps stack overflows instead of corrupting the heap below
+        mprotect(mem, GUARD_SIZE, PROT_NONE);
+        stack = static_cast<char*>(mem);
+    }
+    if (task->state == Task::State::Pending) {
+        // A task sees the main program's variables as they are when it starts; the main
+        // program is waiting, so every task started in this wait shares one snapshot
+        if (!startScope) startScope = std::make_shared<const std::unordered_map<std::string, Value>>(interp.variables);
+        task->inherited = startScope;
+        task->context = std::make_unique<ucontext_t>();
+        getcontext(task->context.get());
+        task->context->uc_stack.ss_sp = stack + GUARD_SIZE;
+        task->context->uc_stack.ss_size = STACK_SIZE;
+        task->context->uc_link = &loopContext;
+        uintptr_t self = reinterpret_cast<uintptr_t>(this);
+        makecontext(task->context.get(), reinterpret_cast<void (*)()>(trampoline), 2,
+                    static_cast<unsigned>(self), static_cast<unsigned>(self >> 32));
+    } else {
+        // Put back the frames the task was suspended in, at the addresses they had
+        std::copy(task->savedStack.begin(), task->savedStack.end(), stackTop() - task->savedStack.size());
+    }
+    task->state = Task::State::Running;
+    current = task;
+    swapState(task);
+    const char* threadFloor = budget::stackFloor();
+    budget::stackFloor() = stack + GUARD_SIZE + budget::STACK_RESERVE;
+    swapcontext(&loopContext, task->context.get());
+    budget::stackFloor() = threadFloor;
+    swapState(task);
+    current = nullptr;
+    if (task->state == Task::State::Done) {
+        task->savedStack = {};
+        task->context.reset();
+        task->variables.clear();
+        task->inherited.reset();
+        task->callStack.clear();
+        live.erase(task);
+        return;
+    }
+    // Suspended: keep the stack from its stack pointer up, since the next task overwrites it
+    const char* low = stackPointerOf(*task->context);
+    if (!low) low = stack + GUARD_SIZE;
+    task->savedStack.assign(low, static_cast<const char*>(stackTop()));
+}
+
+void Scheduler::suspendCurrent() {
+    if (current) {
+        Task* task = current;
+        task->state = Task::State::Suspended;
+        swapcontext(task->context.get(), &loopContext);
+        return;
+    }
+    runUntil([&] { return rootWoken; });
+    rootWoken = false;
+}
+
+void Scheduler::runUntil(const std::function<bool()>& done) {
+    // The main program may have changed its variables since it last waited
+    startScope.reset();
+    while (!done()) {
+        if (!ready.empty()) {
+            Task* task = ready.front();
+            ready.pop_front();
+            resume(task);
+            continue;
+        }
+        auto now = Clock::now();
+        if (!timers.empty() && timers.begin()->first <= now) {
+            Task* task = timers.begin()->second;
+            timers.erase(timers.begin());
+            wake(task);
+            continue;
+        }
+        if (timers.empty() && ioWaiters == 0) throw std::runtime_error("await: deadlock, no task can make progress");
+        int timeout = -1;
+        if (!timers.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers.begin()->first - now).count();
+            timeout = static_cast<int>(wait) + 1;
+        }
+        if (epollFd < 0) epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event events[64];
+        int n = epoll_wait(epollFd, events, 64, timeout);
+        if (n < 0 && errno != EINTR) throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+        for (int i = 0; i < n; ++i) wake(static_cast<Task*>(events[i].data.ptr));
+    }
+}
+
+void Scheduler::sleep(double ms) {
+    auto deadline = Clock::now() + std::chrono::microseconds(static_cast<long long>(ms * 1000));
+    timers.emplace(deadline, current);
+    suspendCurrent();
+}
+
+void Scheduler::waitReadable(int fd) {
+    if (epollFd < 0) epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = current;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        throw std::runtime_error(std::string("epoll_ctl: ") + std::strerror(errno));
+    }
+    ++ioWaiters;
+    suspendCurrent();
+    --ioWaiters;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+std::string Scheduler::runCommand(const std::string& command) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) throw std::runtime_error("run: cannot create pipe");
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    std::string shell = "/bin/sh", flag = "-c", script = command;
+    char* argv[] = {&shell[0], &flag[0], &script[0], nullptr};
+    // In a process group of its own, so stopping it stops whatever the shell started
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attributes, argv, environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (rc != 0) {
+        close(fds[0]);
+        throw std::runtime_error("run: cannot start /bin/sh");
+    }
+    // Closes the pipe and reaps the child however the read ends; a read cut short kills it
+    struct Child {
+        std::unordered_map<int, pid_t>& running;
+        int fd;
+        pid_t pid;
+        bool finished = false;
+        ~Child() {
+            running.erase(fd);
+            closeAndReap(fd, pid, !finished);
+        }
+    } child{commands, fds[0], pid};
+    commands[child.fd] = pid;
+    fcntl(child.fd, F_SETFL, fcntl(child.fd, F_GETFL) | O_NONBLOCK);
+    // Read straight into the result: a buffer on the task stack would be saved with it
+    constexpr size_t CHUNK = 65536;
+    std::string output;
+    while (true) {
+        size_t used = output.size();
+        output.resize(used + CHUNK);
+        ssize_t n = read(child.fd, &output[used], CHUNK);
+        int error = errno;
+        output.resize(used + std::max<ssize_t>(n, 0));
+        if (n > 0) {
+            continue;
+        } else if (n == 0) {
+            break;
+        } else if (error == EAGAIN || error == EWOULDBLOCK) {
+            waitReadable(child.fd);
+        } else if (error != EINTR) {
+            throw std::runtime_error(std::string("run: read failed: ") + std::strerror(error));
+        }
+    }
+    child.finished = true;
+    return output;
+}
+
+#else // no fibers: tasks run to completion when first awaited or drained
+
+void Scheduler::resume(Task* task) {
+    task->state = Task::State::Running;
+    try {
+        task->result = interp.callFunction(task->func, task->args);
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    finish(task);
+    live.erase(task);
+}
+
+void Scheduler::suspendCurrent() {}
+
+void Scheduler::runUntil(const std::function<bool()>& done) {
+    while (!done() && !ready.empty()) {
+        Task* task = ready.front();
+        ready.pop_front();
+        if (task->state == Task::State::Pending) resume(task);
+    }
+}
+
+void Scheduler::sleep(double ms) {
+    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(ms * 1000)));
+}
+
+void Scheduler::waitReadable(int) {}
+
+std::string Scheduler::runCommand(const std::string& command) {
+#ifdef _WIN32
+    FILE* pipe = _popen(command.c_str(), "r");
+#else
+    FILE* pipe = popen(command.c_str(), "r");
+#endif
+    if (!pipe) throw std::runtime_error("run: cannot start command");
+    std::string output;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) output.append(buffer, n);
+#ifdef _WIN32
+    _pclose(pipe);
+#else
+    pclose(pipe);
+#endif
+    return output;
+}
+
+#endif
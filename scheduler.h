@@ -0,0 +1,105 @@
+#pragma once
+#include "ast.h"
+#include "profiler.h"
+#include "value.h"
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#define ZEN_HAVE_FIBERS 1
+#include <sys/types.h>
+#include <ucontext.h>
+#endif
+
+class Interpreter;
+
+// A spawned call. Until it first runs a task is just the function and its arguments.
+// Once started it runs on the scheduler's one task stack; while it waits, the part of
+// that stack it was using is kept here, so a waiting task costs what it actually used
+// (a few KB for a typical call chain) rather than a stack of its own. It reads the main
+// program's variables through a snapshot shared with the tasks started alongside it.
+struct Task {
+    enum class State { Pending, Running, Suspended, Done };
+    const FunctionNode* func;
+    std::vector<Value> args;
+    State state = State::Pending;
+    Value result;
+    std::exception_ptr error;
+    std::vector<Task*> waiters; // tasks suspended in `await` on this one
+    bool awaited = false;
+
+    // Interpreter state while the task is not the one running
+    std::unordered_map<std::string, Value> variables;
+    std::shared_ptr<const std::unordered_map<std::string, Value>> inherited;
+    std::vector<std::unordered_map<std::string, Value>> callStack;
+    bool hasReturn = false;
+    Value returnValue;
+    uint32_t callDepth = 0;
+    profiler::Stack profileStack;
+    // Stays empty: a task's function, like any callee, writes its own copies
+    std::unordered_map<std::string, Value*> sharedTargets;
+
+#ifdef ZEN_HAVE_FIBERS
+    std::unique_ptr<ucontext_t> context; // from the first run until the task is done
+    std::vector<char> savedStack; // the in-use top of the task stack while suspended
+#endif
+};
+
+// Single-threaded cooperative scheduler for one interpreter. Tasks take turns on one
+// stack and switch only at `await`, `sleep` and pipe reads; when nothing is ready the
+// loop blocks in epoll until a file descriptor or timer wakes a task. The main program
+// is not a task: when it waits, it drives the loop until its condition is met.
+class Scheduler {
+public:
+    explicit Scheduler(Interpreter& interp);
+    ~Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    std::shared_ptr<Task> spawn(const FunctionNode* func, std::vector<Value> args);
+    // Suspends the current task (or runs the loop, from the main program) until task finishes
+    Value await(const std::shared_ptr<Task>& task);
+    void sleep(double ms);
+    // Runs a shell command and returns its standard output, suspending while the pipe is empty
+    std::string runCommand(const std::string& command);
+    // Runs until every spawned task has finished
+    void drain();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Interpreter& interp;
+    Task* current = nullptr; // nullptr while the main program runs
+    std::deque<Task*> ready;
+    std::unordered_map<Task*, std::shared_ptr<Task>> live;
+    std::multimap<Clock::time_point, Task*> timers;
+    size_t ioWaiters = 0;
+    bool rootWoken = false;
+    int epollFd = -1;
+    // Variables of the main program for the tasks started during one wait
+    std::shared_ptr<const std::unordered_map<std::string, Value>> startScope;
+    std::vector<std::shared_ptr<Task>> failed; // reported by drain() unless someone awaited them
+
+    void wake(Task* task);
+    // Blocks the caller until wake() is called for it
+    void suspendCurrent();
+    void waitReadable(int fd);
+    void runUntil(const std::function<bool()>& done);
+    void resume(Task* task);
+    void swapState(Task* task);
+    void finish(Task* task);
+#ifdef ZEN_HAVE_FIBERS
+    ucontext_t loopContext;
+    char* stack = nullptr; // mapped on first use, guard page included
+    std::unordered_map<int, pid_t> commands; // run() children in flight, by pipe
+    static void trampoline(unsigned lo, unsigned hi);
+    char* stackTop() const;
+#endif
+};
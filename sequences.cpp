@@ -0,0 +1,114 @@
+#include "sequences.h"
+#include "interpreter.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+class RangeSequence : public Sequence {
+public:
+    RangeSequence(double start, double end, double step) : start(start), end(end), step(step) {}
+    void forEach(Interpreter&, const std::function<bool(Value)>& f) const override {
+        // Stepping by index keeps long fractional ranges from drifting
+        for (double i = 0;; ++i) {
+            double x = start + i * step;
+            if (step > 0 ? x >= end : x <= end) return;
+            if (!f(x)) return;
+        }
+    }
+    std::string describe() const override {
+        std::ostringstream os;
+        os << "range " << start << " to " << end << " by " << step;
+        return os.str();
+    }
+private:
+    double start, end, step;
+};
+
+class PackSequence : public Sequence {
+public:
+    explicit PackSequence(Value pack) : pack(std::move(pack)) {}
+    void forEach(Interpreter&, const std::function<bool(Value)>& f) const override {
+        if (std::holds_alternative<Matrix>(pack)) {
+            const auto& m = std::get<Matrix>(pack);
+            for (size_t r = 0; r < m.rows; ++r) {
+                const double* row = m.values() + r * m.cols;
+                if (!f(makeNumPack(std::vector<double>(row, row + m.cols)))) return;
+            }
+            return;
+        }
+        size_t n = packSize(pack);
+        for (size_t i = 0; i < n; ++i) {
+            if (!f(packAt(pack, i))) return;
+        }
+    }
+    std::string describe() const override { return "pack of " + std::to_string(packSize(pack)); }
+private:
+    Value pack; // shares the pack's storage, so later writes to the variable are not seen
+};
+
+class MapSequence : public Sequence {
+public:
+    MapSequence(SequencePtr source, FunctionRef func) : source(std::move(source)), func(std::move(func)) {}
+    void forEach(Interpreter& interp, const std::function<bool(Value)>& f) const override {
+        source->forEach(interp, [&](Value v) { return f(interp.callFunction(func.func, {std::move(v)})); });
+    }
+    std::string describe() const override { return "map " + func.func->name + " over " + source->describe(); }
+private:
+    SequencePtr source;
+    FunctionRef func;
+};
+
+class FilterSequence : public Sequence {
+public:
+    FilterSequence(SequencePtr source, FunctionRef predicate) : source(std::move(source)), predicate(std::move(predicate)) {}
+    void forEach(Interpreter& interp, const std::function<bool(Value)>& f) const override {
+        source->forEach(interp, [&](Value v) {
+            if (!isTrue(interp.callFunction(predicate.func, {v}))) return true;
+            return f(std::move(v));
+        });
+    }
+    std::string describe() const override { return "filter " + predicate.func->name + " over " + source->describe(); }
+private:
+    SequencePtr source;
+    FunctionRef predicate;
+};
+
+class TakeSequence : public Sequence {
+public:
+    TakeSequence(SequencePtr source, size_t n) : source(std::move(source)), n(n) {}
+    void forEach(Interpreter& interp, const std::function<bool(Value)>& f) const override {
+        if (n == 0) return;
+        size_t seen = 0;
+        source->forEach(interp, [&](Value v) { return f(std::move(v)) && ++seen < n; });
+    }
+    std::string describe() const override { return "take " + std::to_string(n) + " of " + source->describe(); }
+private:
+    SequencePtr source;
+    size_t n;
+};
+
+} // namespace
+
+SequencePtr rangeOf(double start, double end, double step) {
+    if (step == 0) throw std::runtime_error("range: step must not be zero");
+    return std::make_shared<RangeSequence>(start, end, step);
+}
+
+SequencePtr asSequence(const Value& source, const char* caller) {
+    if (std::holds_alternative<SequencePtr>(source)) return std::get<SequencePtr>(source);
+    if (isPack(source) || std::holds_alternative<Matrix>(source)) return std::make_shared<PackSequence>(source);
+    throw std::runtime_error(std::string(caller) + ": expected a pack or a sequence");
+}
+
+SequencePtr mapOf(SequencePtr source, FunctionRef func) {
+    return std::make_shared<MapSequence>(std::move(source), std::move(func));
+}
+
+SequencePtr filterOf(SequencePtr source, FunctionRef predicate) {
+    return std::make_shared<FilterSequence>(std::move(source), std::move(predicate));
+}
+
+SequencePtr takeOf(SequencePtr source, size_t n) {
+    return std::make_shared<TakeSequence>(std::move(source), n);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "value.h"
+
+// Lazy pipelines: range(), map(), filter() and take() build sequences without computing
+// anything. Each stage hands its elements straight to the next one, so for-in, reduce()
+// or collect() run the whole chain in a single pass with no intermediate packs.
+
+// range(a, b, step): a, a + step, ... up to but not including b
+SequencePtr rangeOf(double start, double end, double step);
+// Packs and matrices (by row) as sequences; sequences are returned as they are
+SequencePtr asSequence(const Value& source, const char* caller);
+SequencePtr mapOf(SequencePtr source, FunctionRef func);
+SequencePtr filterOf(SequencePtr source, FunctionRef predicate);
+// The first n elements; the source stops being pulled once they have gone by
+SequencePtr takeOf(SequencePtr source, size_t n);
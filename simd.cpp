@@ -0,0 +1,346 @@
+#include "simd.h"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ZEN_SIMD_X86 1
+#define ZEN_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define ZEN_SIMD_X86 1
+#define ZEN_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Operand shapes for binary kernels: vector-vector, vector-scalar, scalar-vector
+enum Mode { VV, VS, SV };
+
+using BinaryKernel = void (*)(const double* a, const double* b, double s, double* out, size_t n);
+using ReduceKernel = double (*)(const double* a, size_t n);
+using DotKernel = double (*)(const double* a, const double* b, size_t n);
+
+struct Kernels {
+    BinaryKernel binary[4][3];
+    ReduceKernel sum;
+    ReduceKernel min;
+    ReduceKernel max;
+    DotKernel dot;
+    simd::Level level;
+    const char* name;
+};
+
+template <int OP>
+inline double apply(double x, double y) {
+    if constexpr (OP == 0) return x + y;
+    else if constexpr (OP == 1) return x - y;
+    else if constexpr (OP == 2) return x * y;
+    else return x / y;
+}
+
+// Scalar fallback
+
+template <int OP, int MODE>
+void scalarBinary(const double* a, const double* b, double s, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        double x = MODE == SV ? s : a[i];
+        double y = MODE == VS ? s : b[i];
+        out[i] = apply<OP>(x, y);
+    }
+}
+
+double scalarSum(const double* a, size_t n) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) acc += a[i];
+    return acc;
+}
+
+// min and max are NaN when any element is, on every kernel. These finish a reduction
+// from m over a[i..n).
+inline double minFrom(double m, const double* a, size_t i, size_t n) {
+    for (; i < n; ++i) {
+        if (a[i] < m) m = a[i];
+        else if (a[i] != a[i]) return a[i];
+    }
+    return m;
+}
+
+inline double maxFrom(double m, const double* a, size_t i, size_t n) {
+    for (; i < n; ++i) {
+        if (a[i] > m) m = a[i];
+        else if (a[i] != a[i]) return a[i];
+    }
+    return m;
+}
+
+double scalarMin(const double* a, size_t n) { return minFrom(a[0], a, 1, n); }
+double scalarMax(const double* a, size_t n) { return maxFrom(a[0], a, 1, n); }
+
+const double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+
+double scalarDot(const double* a, const double* b, size_t n) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) acc += a[i] * b[i];
+    return acc;
+}
+
+#define ZEN_BINARY_TABLE(kernel) { \
+    { kernel<0, VV>, kernel<0, VS>, kernel<0, SV> }, \
+    { kernel<1, VV>, kernel<1, VS>, kernel<1, SV> }, \
+    { kernel<2, VV>, kernel<2, VS>, kernel<2, SV> }, \
+    { kernel<3, VV>, kernel<3, VS>, kernel<3, SV> } }
+
+const Kernels scalarKernels = {
+    ZEN_BINARY_TABLE(scalarBinary), scalarSum, scalarMin, scalarMax, scalarDot, simd::Level::Scalar, "scalar"
+};
+
+#ifdef ZEN_SIMD_X86
+
+// SSE2 (baseline on x86-64): 2 doubles per vector
+
+template <int OP>
+inline __m128d sse2Apply(__m128d x, __m128d y) {
+    if constexpr (OP == 0) return _mm_add_pd(x, y);
+    else if constexpr (OP == 1) return _mm_sub_pd(x, y);
+    else if constexpr (OP == 2) return _mm_mul_pd(x, y);
+    else return _mm_div_pd(x, y);
+}
+
+template <int OP, int MODE>
+void sse2Binary(const double* a, const double* b, double s, double* out, size_t n) {
+    const __m128d vs = _mm_set1_pd(s);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d x0 = MODE == SV ? vs : _mm_loadu_pd(a + i);
+        __m128d x1 = MODE == SV ? vs : _mm_loadu_pd(a + i + 2);
+        __m128d y0 = MODE == VS ? vs : _mm_loadu_pd(b + i);
+        __m128d y1 = MODE == VS ? vs : _mm_loadu_pd(b + i + 2);
+        _mm_storeu_pd(out + i, sse2Apply<OP>(x0, y0));
+        _mm_storeu_pd(out + i + 2, sse2Apply<OP>(x1, y1));
+    }
+    scalarBinary<OP, MODE>(MODE == SV ? a : a + i, MODE == VS ? b : b + i, s, out + i, n - i);
+}
+
+inline double sse2Horizontal(__m128d v) {
+    return _mm_cvtsd_f64(v) + _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+}
+
+double sse2Sum(const double* a, size_t n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+    }
+    double acc = sse2Horizontal(_mm_add_pd(acc0, acc1));
+    for (; i < n; ++i) acc += a[i];
+    return acc;
+}
+
+double sse2Min(const double* a, size_t n) {
+    if (n < 2) return scalarMin(a, n);
+    // _mm_min_pd drops a NaN in its first operand, so NaNs are tracked on the side
+    __m128d m = _mm_loadu_pd(a);
+    __m128d nan = _mm_cmpunord_pd(m, m);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        nan = _mm_or_pd(nan, _mm_cmpunord_pd(x, x));
+        m = _mm_min_pd(m, x);
+    }
+    if (_mm_movemask_pd(nan)) return NOT_A_NUMBER;
+    m = _mm_min_sd(m, _mm_unpackhi_pd(m, m));
+    return minFrom(_mm_cvtsd_f64(m), a, i, n);
+}
+
+double sse2Max(const double* a, size_t n) {
+    if (n < 2) return scalarMax(a, n);
+    // _mm_max_pd drops a NaN in its first operand, so NaNs are tracked on the side
+    __m128d m = _mm_loadu_pd(a);
+    __m128d nan = _mm_cmpunord_pd(m, m);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        nan = _mm_or_pd(nan, _mm_cmpunord_pd(x, x));
+        m = _mm_max_pd(m, x);
+    }
+    if (_mm_movemask_pd(nan)) return NOT_A_NUMBER;
+    m = _mm_max_sd(m, _mm_unpackhi_pd(m, m));
+    return maxFrom(_mm_cvtsd_f64(m), a, i, n);
+}
+
+double sse2Dot(const double* a, const double* b, size_t n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double acc = sse2Horizontal(_mm_add_pd(acc0, acc1));
+    for (; i < n; ++i) acc += a[i] * b[i];
+    return acc;
+}
+
+const Kernels sse2Kernels = {
+    ZEN_BINARY_TABLE(sse2Binary), sse2Sum, sse2Min, sse2Max, sse2Dot, simd::Level::Sse2, "sse2"
+};
+
+// AVX2: 4 doubles per vector, compiled for AVX2 only in these functions
+
+template <int OP>
+ZEN_TARGET_AVX2 inline __m256d avx2Apply(__m256d x, __m256d y) {
+    if constexpr (OP == 0) return _mm256_add_pd(x, y);
+    else if constexpr (OP == 1) return _mm256_sub_pd(x, y);
+    else if constexpr (OP == 2) return _mm256_mul_pd(x, y);
+    else return _mm256_div_pd(x, y);
+}
+
+template <int OP, int MODE>
+ZEN_TARGET_AVX2 void avx2Binary(const double* a, const double* b, double s, double* out, size_t n) {
+    const __m256d vs = _mm256_set1_pd(s);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d x0 = MODE == SV ? vs : _mm256_loadu_pd(a + i);
+        __m256d x1 = MODE == SV ? vs : _mm256_loadu_pd(a + i + 4);
+        __m256d y0 = MODE == VS ? vs : _mm256_loadu_pd(b + i);
+        __m256d y1 = MODE == VS ? vs : _mm256_loadu_pd(b + i + 4);
+        _mm256_storeu_pd(out + i, avx2Apply<OP>(x0, y0));
+        _mm256_storeu_pd(out + i + 4, avx2Apply<OP>(x1, y1));
+    }
+    scalarBinary<OP, MODE>(MODE == SV ? a : a + i, MODE == VS ? b : b + i, s, out + i, n - i);
+}
+
+ZEN_TARGET_AVX2 inline double avx2Horizontal(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(lo) + _mm_cvtsd_f64(_mm_unpackhi_pd(lo, lo));
+}
+
+ZEN_TARGET_AVX2 double avx2Sum(const double* a, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    double acc = avx2Horizontal(_mm256_add_pd(acc0, acc1));
+    for (; i < n; ++i) acc += a[i];
+    return acc;
+}
+
+ZEN_TARGET_AVX2 double avx2Min(const double* a, size_t n) {
+    if (n < 4) return scalarMin(a, n);
+    __m256d m = _mm256_loadu_pd(a);
+    __m256d nan = _mm256_cmp_pd(m, m, _CMP_UNORD_Q);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+        m = _mm256_min_pd(m, x);
+    }
+    if (_mm256_movemask_pd(nan)) return NOT_A_NUMBER;
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    return minFrom(scalarMin(lanes, 4), a, i, n);
+}
+
+ZEN_TARGET_AVX2 double avx2Max(const double* a, size_t n) {
+    if (n < 4) return scalarMax(a, n);
+    __m256d m = _mm256_loadu_pd(a);
+    __m256d nan = _mm256_cmp_pd(m, m, _CMP_UNORD_Q);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+        m = _mm256_max_pd(m, x);
+    }
+    if (_mm256_movemask_pd(nan)) return NOT_A_NUMBER;
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    return maxFrom(scalarMax(lanes, 4), a, i, n);
+}
+
+ZEN_TARGET_AVX2 double avx2Dot(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double acc = avx2Horizontal(_mm256_add_pd(acc0, acc1));
+    for (; i < n; ++i) acc += a[i] * b[i];
+    return acc;
+}
+
+const Kernels avx2Kernels = {
+    ZEN_BINARY_TABLE(avx2Binary), avx2Sum, avx2Min, avx2Max, avx2Dot, simd::Level::Avx2, "avx2"
+};
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    __cpuidex(info, 7, 0);
+    return fma && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#endif // ZEN_SIMD_X86
+
+// ZEN_SIMD=scalar|sse2|avx2 forces a lower instruction set (useful for testing fallbacks)
+const Kernels& selectKernels() {
+    const char* forced = std::getenv("ZEN_SIMD");
+    if (forced && std::strcmp(forced, "scalar") == 0) return scalarKernels;
+#ifdef ZEN_SIMD_X86
+    if (forced && std::strcmp(forced, "sse2") == 0) return sse2Kernels;
+    if (cpuHasAvx2()) return avx2Kernels;
+    return sse2Kernels;
+#else
+    return scalarKernels;
+#endif
+}
+
+const Kernels& kernels() {
+    static const Kernels& selected = selectKernels();
+    return selected;
+}
+
+int modeIndex(Mode m) { return static_cast<int>(m); }
+int opIndex(simd::Op op) { return static_cast<int>(op); }
+
+} // namespace
+
+namespace simd {
+
+void binary(Op op, const double* a, const double* b, double* out, size_t n) {
+    kernels().binary[opIndex(op)][modeIndex(VV)](a, b, 0.0, out, n);
+}
+
+void binaryScalar(Op op, const double* a, double s, double* out, size_t n) {
+    kernels().binary[opIndex(op)][modeIndex(VS)](a, nullptr, s, out, n);
+}
+
+void scalarBinary(Op op, double s, const double* b, double* out, size_t n) {
+    kernels().binary[opIndex(op)][modeIndex(SV)](nullptr, b, s, out, n);
+}
+
+double sum(const double* a, size_t n) { return kernels().sum(a, n); }
+double min(const double* a, size_t n) { return kernels().min(a, n); }
+double max(const double* a, size_t n) { return kernels().max(a, n); }
+double dot(const double* a, const double* b, size_t n) { return kernels().dot(a, b, n); }
+
+Level level() { return kernels().level; }
+const char* isa() { return kernels().name; }
+
+} // namespace simd
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+
+// Vectorized kernels over contiguous doubles.
+// The implementation (AVX2, SSE2 or scalar) is picked once per process from the running CPU.
+namespace simd {
+
+enum class Op { Add, Sub, Mul, Div };
+
+// out[i] = a[i] op b[i]
+void binary(Op op, const double* a, const double* b, double* out, size_t n);
+// out[i] = a[i] op s
+void binaryScalar(Op op, const double* a, double s, double* out, size_t n);
+// out[i] = s op b[i]
+void scalarBinary(Op op, double s, const double* b, double* out, size_t n);
+
+double sum(const double* a, size_t n);
+// min and max are NaN if any element is; n must be > 0
+double min(const double* a, size_t n);
+double max(const double* a, size_t n);
+// The same rule for two numbers
+inline double min(double a, double b) { return b < a || b != b ? b : a; }
+inline double max(double a, double b) { return b > a || b != b ? b : a; }
+double dot(const double* a, const double* b, size_t n);
+
+enum class Level { Scalar, Sse2, Avx2 };
+
+// Selected instruction set; Avx2 also implies FMA support
+Level level();
+// Name of the selected instruction set ("avx2", "sse2" or "scalar")
+const char* isa();
+
+} // namespace simd
@@ -0,0 +1,201 @@
+#include "sort.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// Below this many elements a sort runs on the calling thread alone
+constexpr size_t PARALLEL_MIN = 1 << 16;
+constexpr uint64_t SIGN = 1ull << 63;
+// 11-bit digits: six passes over the data instead of eight, with counts that fit in L1
+constexpr int DIGIT_BITS = 11;
+constexpr size_t BUCKETS = size_t(1) << DIGIT_BITS;
+
+// Maps a double to an unsigned key with the same order; every NaN maps to the largest key
+uint64_t keyOf(double d) {
+    if (d != d) return ~0ull;
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return (bits & SIGN) ? ~bits : bits | SIGN;
+}
+
+size_t chunkCount(size_t n) {
+    size_t threads = ThreadPool::instance().size();
+    if (threads == 1 || n < PARALLEL_MIN) return 1;
+    return std::min(threads * 4, n / (PARALLEL_MIN / 4));
+}
+
+// LSD radix sort of records on an unsigned 64-bit key, one digit per pass. Each pass
+// counts digits per chunk, then every chunk scatters into its own precomputed slots, so
+// chunks run in parallel and equal keys keep their order. A digit that is the same in
+// every key (the high bits of small integers, say) skips its pass.
+template <typename Record, typename KeyOf>
+void radixSortRecords(Record* records, size_t n, KeyOf key) {
+    if (n < 2) return;
+    size_t chunks = chunkCount(n);
+    size_t per = (n + chunks - 1) / chunks;
+    auto& pool = ThreadPool::instance();
+    std::vector<Record> buffer(n);
+    Record* src = records;
+    Record* dst = buffer.data();
+    std::vector<std::array<size_t, BUCKETS>> counts(chunks);
+
+    for (int shift = 0; shift < 64; shift += DIGIT_BITS) {
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                auto& count = counts[c];
+                count.fill(0);
+                size_t last = std::min(n, (c + 1) * per);
+                for (size_t i = c * per; i < last; ++i) ++count[(key(src[i]) >> shift) & (BUCKETS - 1)];
+            }
+        });
+        // Turn the counts into each chunk's first slot per digit
+        size_t offset = 0;
+        bool trivial = false;
+        for (size_t digit = 0; digit < BUCKETS; ++digit) {
+            size_t total = 0;
+            for (size_t c = 0; c < chunks; ++c) total += counts[c][digit];
+            if (total == n) trivial = true;
+            for (size_t c = 0; c < chunks; ++c) {
+                size_t count = counts[c][digit];
+                counts[c][digit] = offset;
+                offset += count;
+            }
+        }
+        if (trivial) continue;
+        pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                auto& next = counts[c];
+                size_t last = std::min(n, (c + 1) * per);
+                for (size_t i = c * per; i < last; ++i) dst[next[(key(src[i]) >> shift) & (BUCKETS - 1)]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != records) std::copy(src, src + n, records);
+}
+
+// Stable merge sort: sorted runs in parallel, then rounds of pairwise merges in parallel
+template <typename T, typename Less>
+void mergeSort(std::vector<T>& items, Less less) {
+    size_t n = items.size();
+    size_t runs = chunkCount(n);
+    if (runs == 1) {
+        std::stable_sort(items.begin(), items.end(), less);
+        return;
+    }
+    auto& pool = ThreadPool::instance();
+    size_t run = (n + runs - 1) / runs;
+    pool.parallelFor(runs, 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            auto first = items.begin() + static_cast<std::ptrdiff_t>(std::min(n, r * run));
+            auto last = items.begin() + static_cast<std::ptrdiff_t>(std::min(n, (r + 1) * run));
+            std::stable_sort(first, last, less);
+        }
+    });
+    std::vector<T> buffer(n);
+    T* src = items.data();
+    T* dst = buffer.data();
+    for (size_t width = run; width < n; width *= 2) {
+        size_t pairs = (n + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, 1, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                size_t lo = p * 2 * width;
+                size_t mid = std::min(n, lo + width);
+                size_t hi = std::min(n, lo + 2 * width);
+                std::merge(std::make_move_iterator(src + lo), std::make_move_iterator(src + mid),
+                           std::make_move_iterator(src + mid), std::make_move_iterator(src + hi), dst + lo, less);
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != items.data()) std::move(src, src + n, items.data());
+}
+
+void checkSortable(const Value& v) {
+    if (!std::holds_alternative<double>(v) && !isText(v)) {
+        throw std::runtime_error("sort: can only order numbers and text");
+    }
+}
+
+// Element order of a generic pack, or of its keys: indices of the numbers by radix sort,
+// followed by those of the text by merge sort
+std::vector<size_t> sortedOrder(size_t n, const std::function<const Value&(size_t)>& at) {
+    struct Keyed {
+        uint64_t key;
+        size_t index;
+    };
+    std::vector<Keyed> numbers;
+    std::vector<size_t> texts;
+    for (size_t i = 0; i < n; ++i) {
+        const Value& v = at(i);
+        checkSortable(v);
+        if (std::holds_alternative<double>(v)) numbers.push_back({keyOf(std::get<double>(v)), i});
+        else texts.push_back(i);
+    }
+    radixSortRecords(numbers.data(), numbers.size(), [](const Keyed& r) { return r.key; });
+    mergeSort(texts, [&](size_t a, size_t b) { return textOf(at(a)) < textOf(at(b)); });
+    std::vector<size_t> order;
+    order.reserve(n);
+    for (const auto& r : numbers) order.push_back(r.index);
+    order.insert(order.end(), texts.begin(), texts.end());
+    return order;
+}
+
+} // namespace
+
+void radixSort(double* values, size_t n) {
+    // Keys are recomputed on every pass; a few bit operations cost less than a key array
+    radixSortRecords(values, n, keyOf);
+}
+
+Value sortedPack(const Value& pack) {
+    if (std::holds_alternative<NumPack>(pack)) {
+        const auto& p = std::get<NumPack>(pack);
+        std::vector<double> values(p.values(), p.values() + p.size());
+        radixSort(values.data(), values.size());
+        return makeNumPack(std::move(values));
+    }
+    if (!std::holds_alternative<Pack>(pack)) throw std::runtime_error("sort() expects a pack");
+    const auto& p = std::get<Pack>(pack);
+    Pack out;
+    out.reserve(p.size());
+    for (size_t i : sortedOrder(p.size(), [&](size_t i) -> const Value& { return *p[i]; })) out.push_back(p[i]);
+    return out;
+}
+
+Value sortedByKeys(const Value& pack, const std::vector<Value>& keys) {
+    std::vector<size_t> order = sortedOrder(keys.size(), [&](size_t i) -> const Value& { return keys[i]; });
+    if (std::holds_alternative<NumPack>(pack)) {
+        const double* values = std::get<NumPack>(pack).values();
+        std::vector<double> out(order.size());
+        for (size_t i = 0; i < order.size(); ++i) out[i] = values[order[i]];
+        return makeNumPack(std::move(out));
+    }
+    const auto& p = std::get<Pack>(pack);
+    Pack out;
+    out.reserve(order.size());
+    for (size_t i : order) out.push_back(p[i]);
+    return out;
+}
+
+void sortInPlace(Value& target) {
+    if (std::holds_alternative<NumPack>(target)) {
+        auto& p = std::get<NumPack>(target);
+        radixSort(p.mutableData(), p.size());
+        return;
+    }
+    if (!std::holds_alternative<Pack>(target)) throw std::runtime_error("sort_inplace() expects a pack");
+    auto& p = std::get<Pack>(target);
+    std::vector<size_t> order = sortedOrder(p.size(), [&](size_t i) -> const Value& { return *p[i]; });
+    std::vector<std::shared_ptr<Value>> sorted;
+    sorted.reserve(order.size());
+    for (size_t i : order) sorted.push_back(p[i]);
+    std::move(sorted.begin(), sorted.end(), p.mutableData());
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "value.h"
+#include <vector>
+
+// Sorting for packs. Numbers are ordered by an LSD radix sort on their bit patterns and
+// text by a merge sort; both are stable and are split across the thread pool when the
+// pack is large. Numbers sort before text and NaNs after every other number; packs
+// holding anything else cannot be sorted.
+
+// Sorts n doubles ascending in place
+void radixSort(double* values, size_t n);
+// A sorted copy of pack
+Value sortedPack(const Value& pack);
+// A copy of pack ordered by keys, one number or text per element
+Value sortedByKeys(const Value& pack, const std::vector<Value>& keys);
+// Sorts the pack held by target in place, keeping its kind
+void sortInPlace(Value& target);
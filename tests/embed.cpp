@@ -0,0 +1,140 @@
+// Embedding checks that need the C++ API rather than a script: a Context must stay
+// usable after a call() that threw, including one stopped by its limits, and a host
+// that edits a module sees the edit in the programs it compiles next. Exits with status 1 and names the first failed check.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "zen.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (ok) return;
+    std::cerr << "FAILED: " << what << std::endl;
+    ++failures;
+}
+
+// Runs call and reports whether it threw
+template <typename F>
+bool throws(F call) {
+    try {
+        call();
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+std::string text(const zen::Value& value) {
+    std::ostringstream out;
+    printValue(out, value);
+    return out.str();
+}
+
+void callAfterError() {
+    auto program = zen::compile(
+        "func bad(n) {\n"
+        "    var local = 42;\n"
+        "    var p = [1, 2];\n"
+        "    return p[n];\n"
+        "}\n"
+        "func peek() {\n"
+        "    return local;\n"
+        "}\n"
+        "func twice(x) {\n"
+        "    return x * 2;\n"
+        "}\n");
+    std::ostringstream out;
+    zen::Context ctx(program, out);
+    // Calls left counted by a failure would soon exceed the depth limit
+    zen::Limits limits;
+    limits.callDepth = 2;
+    ctx.setLimits(limits);
+    for (int round = 0; round < 5; ++round) {
+        check(throws([&] { ctx.call("bad", {zen::Value(7.0)}); }), "bad(7) throws");
+    }
+    check(throws([&] { ctx.call("peek", {}); }), "the failed call's locals are gone");
+    check(throws([&] { ctx.getVar("n"); }), "the failed call's parameters are gone");
+    check(text(ctx.call("twice", {zen::Value(21.0)})) == "42", "a later call runs normally");
+}
+
+// Each kind of limit stops the call with BudgetExceeded; the next call gets a fresh budget
+void callAfterBudgetExceeded() {
+    auto program = zen::compile(
+        "func spin(n) {\n"
+        "    var i = 0;\n"
+        "    while (i < n) {\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return i;\n"
+        "}\n"
+        "func grow(n) {\n"
+        "    return collect(range(0, n));\n"
+        "}\n"
+        "func down(n) {\n"
+        "    if (n == 0) {\n"
+        "        return 0;\n"
+        "    }\n"
+        "    return down(n - 1) + 1;\n"
+        "}\n");
+    std::ostringstream out;
+    zen::Context ctx(program, out);
+    zen::Limits limits;
+    limits.fuel = 100000;
+    limits.memoryBytes = 64 << 10;
+    limits.callDepth = 50;
+    ctx.setLimits(limits);
+    auto kindOf = [&](const char* name, double arg) {
+        try {
+            ctx.call(name, {zen::Value(arg)});
+        } catch (const zen::BudgetExceeded& e) {
+            return static_cast<int>(e.kind);
+        }
+        return -1;
+    };
+    for (int round = 0; round < 3; ++round) {
+        check(kindOf("spin", 1e9) == static_cast<int>(zen::BudgetExceeded::Kind::Fuel), "spin runs out of fuel");
+        check(kindOf("grow", 1e6) == static_cast<int>(zen::BudgetExceeded::Kind::Memory), "grow runs out of memory");
+        check(kindOf("down", 1000) == static_cast<int>(zen::BudgetExceeded::Kind::Depth), "down nests too deep");
+        check(text(ctx.call("spin", {zen::Value(1000.0)})) == "1000", "spin runs within the fuel");
+        check(text(ctx.call("down", {zen::Value(40.0)})) == "40", "down runs within the depth limit");
+        check(!throws([&] { ctx.call("grow", {zen::Value(1000.0)}); }), "grow runs within the memory limit");
+    }
+    limits = {};
+    limits.deadlineMs = 20;
+    ctx.setLimits(limits);
+    check(kindOf("spin", 1e12) == static_cast<int>(zen::BudgetExceeded::Kind::Deadline), "spin runs out of time");
+    check(text(ctx.call("spin", {zen::Value(10.0)})) == "10", "spin runs within the deadline");
+}
+
+void write(const std::filesystem::path& path, const std::string& text) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+void moduleEditedBetweenCompiles() {
+    auto dir = std::filesystem::temp_directory_path() / "zen_embed_test";
+    std::filesystem::create_directories(dir);
+    write(dir / "answer.mylang", "func answer() {\n    return 1;\n}\n");
+    auto first = zen::compile("#use <answer>\n", dir.string());
+    write(dir / "answer.mylang", "func answer() {\n    return 42;\n}\n");
+    auto second = zen::compile("#use <answer>\n", dir.string());
+    std::ostringstream out;
+    check(text(zen::Context(first, out).call("answer", {})) == "1", "a compiled program keeps the module it loaded");
+    check(text(zen::Context(second, out).call("answer", {})) == "42", "a later compile loads the edited module");
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+} // namespace
+
+int main() {
+    callAfterError();
+    callAfterBudgetExceeded();
+    moduleEditedBetweenCompiles();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+// Lexer and parser checks that need the C++ API: a large source parsed in parallel chunks
+// gives the program a serial parse does, syntax errors name the line a serial parse
+// would, the SIMD scans of the lexer agree at every run length, and programs survive a
+// .zenc round trip. Run at each ZEN_SIMD level with ZEN_THREADS=4. Exits with status 1
+// and names each failed check.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ast_cache.h"
+#include "lexer.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include "zen.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (ok) return;
+    std::cerr << "FAILED: " << what << std::endl;
+    ++failures;
+}
+
+// Every construct the parser knows, with strings and comments that a cut at the wrong
+// `func` or brace would split, repeated until the source has at least bytes bytes
+std::vector<std::string> largeSource(size_t bytes) {
+    std::vector<std::string> lines;
+    size_t size = 0;
+    for (size_t i = 0; size < bytes; ++i) {
+        std::string n = std::to_string(i);
+        std::string prev = i ? std::to_string(i - 1) : "0";
+        std::vector<std::string> f = {
+            "// func decoy" + n + "(x) { in a comment",
+            "func f" + n + "(a, b) {",
+            "    let s = \"text { func g() { \\\"" + n + "\\\" }\";",
+            "\t\t  let p = [1, 2.5, a, \"x\"];",
+            "    let q = p[1:3];",
+            "    let a_rather_long_identifier_that_spans_a_vector_" + n + " = q[0];",
+            "    if (a < b || a == " + n + ") {",
+            "        s = s + \"x\";",
+            "    } else {",
+            "        while (a > 0) {",
+            "            a = a - 1;",
+            "        }",
+            "    }",
+            "    switch (b) {",
+            "        case 1, -2: return 1;",
+            "        case \"k\": return 2;",
+            "        default: b = b + 1;",
+            "    }",
+            "    for i = 0 to 2 step 1 {",
+            "        a = a + i;",
+            "    }",
+            "    for x in p[0:2] {",
+            "        a = a + x;",
+            "    }",
+            "    return a * b + len(s) / 3.25;",
+            "}",
+            "let g" + n + " = f" + n + "(" + n + ", 2) + f" + prev + "(1, 1);",
+        };
+        for (auto& line : f) {
+            size += line.size() + 1;
+            lines.push_back(std::move(line));
+        }
+    }
+    lines.push_back("func twice(x) {");
+    lines.push_back("    return x * 2;");
+    lines.push_back("}");
+    lines.push_back("let t = spawn twice(21);");
+    lines.push_back("print(await t);");
+    lines.push_back("print(g0 + g1);");
+    return lines;
+}
+
+std::string join(const std::vector<std::string>& lines) {
+    std::string source;
+    for (const auto& line : lines) source += line + "\n";
+    return source;
+}
+
+std::string run(const std::shared_ptr<const Program>& program) {
+    std::ostringstream out;
+    zen::Context ctx(program, out);
+    ctx.run();
+    return out.str();
+}
+
+std::shared_ptr<const Program> serialParse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return std::make_shared<const Program>(parser.parse(), ".");
+}
+
+std::string compileError(const std::string& source) {
+    try {
+        zen::compile(source);
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+void parallelParseMatchesSerial() {
+    check(ThreadPool::instance().size() > 1, "the pool has threads to parse on");
+    std::string source = join(largeSource(1024 * 1024));
+    auto parallel = zen::compile(source);
+    auto serial = serialParse(source);
+    check(serializeProgram(*parallel, 0) == serializeProgram(*serial, 0), "parallel and serial parses give the same AST");
+    std::string output = run(serial);
+    check(!output.empty() && run(parallel) == output, "parallel and serial parses run alike");
+}
+
+void errorsNameTheFirstBadLine() {
+    auto lines = largeSource(1024 * 1024);
+    size_t late = lines.size() - 40;
+    size_t early = 100;
+    lines[late] = "let = ;";
+    std::string message = compileError(join(lines));
+    check(message.rfind("line " + std::to_string(late + 1) + ",", 0) == 0, "an error near the end names its line: " + message);
+    lines[early] = "func (";
+    message = compileError(join(lines));
+    check(message.rfind("line " + std::to_string(early + 1) + ",", 0) == 0, "the first of two errors is reported: " + message);
+}
+
+// Runs of each length up to past two AVX2 widths end on the right byte
+void lexerScansEveryLength() {
+    for (size_t len = 1; len <= 80; ++len) {
+        std::string ident(len, 'a');
+        ident[len - 1] = 'Z';
+        std::string text(len, 'x');
+        if (len >= 3) text[len / 2] = '\\'; // an escape, but never of the closing quote
+        std::string source = std::string(len, ' ') + "\t" + ident + std::string(len, '\n') + "\"" + text + "\" 7 // " + text + "\n8";
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+        bool ok = tokens.size() == 5 && tokens[0].type == TokenType::Identifier && tokens[0].value == ident &&
+                  tokens[0].offset == len + 1 && tokens[1].type == TokenType::String && tokens[2].value == "7" &&
+                  tokens[3].value == "8" && tokens[4].type == TokenType::EndOfFile;
+        check(ok, "lexing runs of length " + std::to_string(len));
+    }
+}
+
+void cacheRoundTrip() {
+    std::string source = join(largeSource(64 * 1024));
+    auto program = zen::compile(source);
+    uint64_t hash = hashSource(source);
+    std::string bytes = serializeProgram(*program, hash);
+    auto loaded = deserializeProgram(bytes.data(), bytes.size(), hash, ".");
+    check(loaded != nullptr, "a cache loads back");
+    if (!loaded) return;
+    check(serializeProgram(*loaded, hash) == bytes, "a loaded cache encodes to the same bytes");
+    check(run(loaded) == run(program), "a loaded cache runs like the parsed program");
+    check(deserializeProgram(bytes.data(), bytes.size(), hash + 1, ".") == nullptr, "a cache for other source is ignored");
+}
+
+} // namespace
+
+int main() {
+    try {
+        parallelParseMatchesSerial();
+        errorsNameTheFirstBadLine();
+        lexerScansEveryLength();
+        cacheRoundTrip();
+    } catch (const std::exception& e) {
+        check(false, e.what());
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+# Runs SCRIPT with ZEN. With EXPECTED it must exit cleanly and print exactly that file;
+# with EXPECTED_ERROR it must fail and report that file's text somewhere on stderr.
+# The script runs in WORKDIR, emptied and filled with a copy of tests/data first, so it
+# can open the data files by name and write files of its own.
+# Its .zenc cache is kept there too. ARGS are zen options passed before the script, and
+# with EXPECTED_STATUS a failing script must exit with exactly that status.
+file(REMOVE_RECURSE ${WORKDIR})
+file(COPY ${CMAKE_CURRENT_LIST_DIR}/data/ DESTINATION ${WORKDIR})
+set(ENV{ZEN_CACHE_DIR} ${WORKDIR}/cache)
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+# With WARM the script runs twice, and the second run must start from the cache the first
+# one wrote and print the same
+if(WARM)
+    execute_process(COMMAND ${ZEN} ${args} ${SCRIPT} WORKING_DIRECTORY ${WORKDIR} OUTPUT_QUIET ERROR_QUIET)
+    set(timings --timings)
+endif()
+execute_process(
+    COMMAND ${ZEN} ${timings} ${args} ${SCRIPT}
+    WORKING_DIRECTORY ${WORKDIR}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE status
+)
+if(DEFINED EXPECTED_ERROR)
+    file(READ ${EXPECTED_ERROR} expected)
+    string(STRIP "${expected}" expected)
+    string(FIND "${errors}" "${expected}" at)
+    if(status EQUAL 0 OR at EQUAL -1)
+        message(FATAL_ERROR "${SCRIPT} exited with ${status} and reported:\n${errors}\nexpected:\n${expected}")
+    endif()
+    if(DEFINED EXPECTED_STATUS AND NOT status EQUAL EXPECTED_STATUS)
+        message(FATAL_ERROR "${SCRIPT} exited with ${status}, expected ${EXPECTED_STATUS}:\n${errors}")
+    endif()
+    return()
+endif()
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT} exited with ${status}:\n${errors}")
+endif()
+if(WARM)
+    string(FIND "${errors}" "(warm start)" at)
+    if(at EQUAL -1)
+        message(FATAL_ERROR "${SCRIPT} did not start from its cache:\n${errors}")
+    endif()
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "${SCRIPT} printed:\n${output}\nexpected:\n${expected}")
+endif()
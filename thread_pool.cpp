@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+
+namespace {
+
+constexpr size_t NOT_A_WORKER = static_cast<size_t>(-1);
+
+// Index of the pool worker running on this thread, if any
+thread_local size_t currentWorker = NOT_A_WORKER;
+
+size_t defaultThreadCount() {
+    if (const char* env = std::getenv("ZEN_THREADS")) {
+        long n = std::strtol(env, nullptr, 10);
+        if (n > 0) return static_cast<size_t>(n);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(defaultThreadCount());
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    size_t count = threads > 1 ? threads - 1 : 0;
+    for (size_t i = 0; i < count; ++i) queues.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < count; ++i) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    currentWorker = self;
+    while (!stopping) {
+        if (runOne(self)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+    }
+}
+
+bool ThreadPool::popBack(size_t q, Task& task) {
+    std::lock_guard<std::mutex> lock(queues[q]->mutex);
+    if (queues[q]->tasks.empty()) return false;
+    task = std::move(queues[q]->tasks.back());
+    queues[q]->tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::stealFront(size_t q, Task& task) {
+    std::lock_guard<std::mutex> lock(queues[q]->mutex);
+    if (queues[q]->tasks.empty()) return false;
+    task = std::move(queues[q]->tasks.front());
+    queues[q]->tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::runOne(size_t self) {
+    Task task;
+    bool found = self != NOT_A_WORKER && popBack(self, task);
+    size_t start = self == NOT_A_WORKER ? 0 : self + 1;
+    for (size_t i = 0; !found && i < queues.size(); ++i) {
+        found = stealFront((start + i) % queues.size(), task);
+    }
+    if (!found) return false;
+    queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (workers.empty() || chunks == 1) {
+        for (size_t begin = 0; begin < count; begin += grain) body(begin, std::min(begin + grain, count));
+        return;
+    }
+
+    struct Batch {
+        std::atomic<size_t> pending;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    } batch;
+    batch.pending = chunks;
+
+    size_t self = currentWorker;
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t begin = c * grain;
+        size_t end = std::min(begin + grain, count);
+        Task task = [&batch, &body, begin, end] {
+            try {
+                body(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                if (!batch.error) batch.error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (batch.pending.fetch_sub(1) == 1) batch.done.notify_all();
+        };
+        // A worker keeps nested work local for others to steal; an outside caller deals it out
+        size_t q = self != NOT_A_WORKER ? self : c % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+
+    // Help until every chunk of this batch has finished
+    while (batch.pending.load() > 0) {
+        if (runOne(self)) continue;
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        batch.done.wait_for(lock, std::chrono::microseconds(200), [&] { return batch.pending.load() == 0; });
+    }
+    // The last chunk notifies while holding the mutex; wait for it to let go before unwinding
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    if (batch.error) std::rethrow_exception(batch.error);
+}
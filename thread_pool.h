@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker owns a deque: it takes its own work from the
+// back and, when that runs dry, steals from the front of the others' deques.
+class ThreadPool {
+public:
+    // Process-wide pool with one thread per core (ZEN_THREADS overrides the count)
+    static ThreadPool& instance();
+
+    // threads counts the calling thread, so threads - 1 workers are started
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that execute work, including the caller of parallelFor
+    size_t size() const { return workers.size() + 1; }
+
+    // Calls body(begin, end) over [0, count) in chunks of at most grain items and waits for
+    // all of them; the calling thread runs chunks too. Safe to call from inside a chunk.
+    // The first exception thrown by a chunk is rethrown here.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    using Task = std::function<void()>;
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void workerLoop(size_t self);
+    // Runs one queued task, preferring queue `self`; returns false if every queue was empty
+    bool runOne(size_t self);
+    bool popBack(size_t q, Task& task);
+    bool stealFront(size_t q, Task& task);
+};
@@ -3,5 +3,7 @@
 #include <unordered_set>
 
 const std::unordered_set<std::string> KEYWORDS = {
-    "num", "dec", "text", "flag", "pack", "map", "print", "#use"
+    "num", "dec", "text", "flag", "pack", "map", "print", "#use",
+    "let", "if", "else", "while", "for", "parfor", "to", "step", "func", "return", "spawn", "await", "in",
+    "switch", "case", "default"
 }; 
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "value.h"
+#include "mapped_file.h"
+#include "scan.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+double* NumPack::mutableData() {
+    if (data.use_count() > 1 || data->readOnly) *this = makeNumPack(std::vector<double>(values(), values() + size()));
+    return data->values + offset;
+}
+
+NumPack makeNumPack(std::vector<double> values) {
+    auto storage = std::make_shared<NumStorage>();
+    storage->owned = std::move(values);
+    storage->values = storage->owned.data();
+    storage->size = storage->owned.size();
+    storage->charge.set(storage->owned.capacity() * sizeof(double));
+    size_t n = storage->size;
+    return NumPack{std::move(storage), 0, n};
+}
+
+std::shared_ptr<Value>* Pack::mutableData() {
+    if (data.use_count() > 1) {
+        data = std::make_shared<Elements>(begin(), end());
+        offset = 0;
+    }
+    return data->data() + offset;
+}
+
+size_t slotBytes(size_t n) {
+    // The slot's pointer and the cell it points to
+    return n * (sizeof(std::shared_ptr<Value>) + sizeof(Value));
+}
+
+void Pack::reserve(size_t n) {
+    mutableData();
+    data->reserve(offset + n);
+    data->charge.set(slotBytes(data->capacity()));
+}
+
+void Pack::push_back(std::shared_ptr<Value> element) {
+    // Appending to a view that ends before its storage does would overwrite its neighbours
+    if (data.use_count() > 1 || offset + length != data->size()) {
+        data = std::make_shared<Elements>(begin(), end());
+        offset = 0;
+    }
+    data->push_back(std::move(element));
+    ++length;
+    data->charge.set(slotBytes(data->capacity()));
+}
+
+bool isPack(const Value& v) {
+    return std::holds_alternative<Pack>(v) || std::holds_alternative<NumPack>(v);
+}
+
+Map makeMap() {
+    return Map{std::make_shared<Map::Data>()};
+}
+
+const Value* Map::find(std::string_view key) const {
+    auto it = data->index.find(std::string(key));
+    return it == data->index.end() ? nullptr : data->entries[it->second].second.get();
+}
+
+Map::Data& Map::mutableData() {
+    if (data.use_count() > 1) {
+        // Entries are values, so the copy gets its own cells
+        auto copy = std::make_shared<Data>();
+        copy->index = data->index;
+        for (const auto& [key, value] : data->entries) copy->entries.emplace_back(key, std::make_shared<Value>(*value));
+        copy->charge.set(data->charge.bytes());
+        data = std::move(copy);
+    }
+    return *data;
+}
+
+void Map::set(const std::string& key, Value value) {
+    Data& d = mutableData();
+    auto it = d.index.find(key);
+    if (it != d.index.end()) {
+        d.entries[it->second].second = std::make_shared<Value>(std::move(value));
+    } else {
+        d.index.emplace(key, d.entries.size());
+        d.entries.emplace_back(key, std::make_shared<Value>(std::move(value)));
+        // Key twice (entry and index), the cell and the index node
+        d.charge.set(d.charge.bytes() + 2 * key.size() + sizeof(Value) + 64);
+    }
+}
+
+bool isText(const Value& v) {
+    return std::holds_alternative<std::string>(v) || std::holds_alternative<TextView>(v);
+}
+
+std::string_view textOf(const Value& v) {
+    if (std::holds_alternative<TextView>(v)) return std::get<TextView>(v).view();
+    return std::get<std::string>(v);
+}
+
+bool isTrue(const Value& v) {
+    if (std::holds_alternative<double>(v)) return std::get<double>(v) != 0.0;
+    if (isText(v)) return !textOf(v).empty();
+    return false;
+}
+
+void forEachLine(const std::shared_ptr<const MappedFile>& file, const std::function<bool(const TextView&)>& f) {
+    const char* s = file->data();
+    size_t n = file->size();
+    file->adviseSequential();
+    // Pages behind the cursor are handed back every so often to keep memory flat
+    const size_t releaseEvery = 32 << 20;
+    size_t released = 0;
+    for (size_t begin = 0; begin < n;) {
+        if (begin - released >= releaseEvery) {
+            file->releaseBefore(begin);
+            released = begin;
+        }
+        size_t end = scan::find(s, begin, n, '\n');
+        size_t next = end + 1;
+        if (end > begin && s[end - 1] == '\r') --end;
+        if (!f(TextView{file, s + begin, end - begin})) return;
+        begin = next;
+    }
+}
+
+size_t packSize(const Value& v) {
+    if (std::holds_alternative<NumPack>(v)) return std::get<NumPack>(v).size();
+    return std::get<Pack>(v).size();
+}
+
+Value sliceValue(const Value& v, size_t begin, size_t end) {
+    size_t n = isPack(v) ? packSize(v) : isText(v) ? textOf(v).size() : 0;
+    if (!isPack(v) && !isText(v)) throw std::runtime_error("Slicing requires a pack or text");
+    end = std::min(end, n);
+    begin = std::min(begin, end);
+    if (std::holds_alternative<NumPack>(v)) {
+        NumPack view = std::get<NumPack>(v);
+        view.offset += begin;
+        view.length = end - begin;
+        return view;
+    }
+    if (std::holds_alternative<Pack>(v)) {
+        Pack view = std::get<Pack>(v);
+        view.offset += begin;
+        view.length = end - begin;
+        return view;
+    }
+    if (std::holds_alternative<TextView>(v)) {
+        TextView view = std::get<TextView>(v);
+        view.data += begin;
+        view.size = end - begin;
+        return view;
+    }
+    return std::get<std::string>(v).substr(begin, end - begin);
+}
+
+Value packAt(const Value& v, size_t i) {
+    if (std::holds_alternative<NumPack>(v)) return std::get<NumPack>(v).values()[i];
+    return *std::get<Pack>(v)[i];
+}
+
+const double* numericData(const Value& v, std::vector<double>& scratch, size_t& n) {
+    if (std::holds_alternative<NumPack>(v)) {
+        const auto& pack = std::get<NumPack>(v);
+        n = pack.size();
+        return pack.values();
+    }
+    if (!std::holds_alternative<Pack>(v)) throw std::runtime_error("Expected a pack");
+    const auto& pack = std::get<Pack>(v);
+    scratch.clear();
+    scratch.reserve(pack.size());
+    for (const auto& el : pack) {
+        if (!std::holds_alternative<double>(*el)) throw std::runtime_error("Pack contains non-numeric values");
+        scratch.push_back(std::get<double>(*el));
+    }
+    n = scratch.size();
+    return scratch.data();
+}
+
+Value packArith(simd::Op op, const Value& left, const Value& right) {
+    std::vector<double> leftScratch, rightScratch;
+    size_t ln = 0, rn = 0;
+    if (isPack(left) && isPack(right)) {
+        const double* a = numericData(left, leftScratch, ln);
+        const double* b = numericData(right, rightScratch, rn);
+        if (ln != rn) throw std::runtime_error("Pack length mismatch in elementwise operation");
+        std::vector<double> out(ln);
+        simd::binary(op, a, b, out.data(), ln);
+        return makeNumPack(std::move(out));
+    }
+    if (isPack(left) && std::holds_alternative<double>(right)) {
+        const double* a = numericData(left, leftScratch, ln);
+        std::vector<double> out(ln);
+        simd::binaryScalar(op, a, std::get<double>(right), out.data(), ln);
+        return makeNumPack(std::move(out));
+    }
+    if (std::holds_alternative<double>(left) && isPack(right)) {
+        const double* b = numericData(right, rightScratch, rn);
+        std::vector<double> out(rn);
+        simd::scalarBinary(op, std::get<double>(left), b, out.data(), rn);
+        return makeNumPack(std::move(out));
+    }
+    throw std::runtime_error("Invalid operands for elementwise pack operation");
+}
+
+Value matrixArith(simd::Op op, const Value& left, const Value& right) {
+    if (std::holds_alternative<Matrix>(left) && std::holds_alternative<Matrix>(right)) {
+        const auto& a = std::get<Matrix>(left);
+        const auto& b = std::get<Matrix>(right);
+        if (a.rows != b.rows || a.cols != b.cols) throw std::runtime_error("Matrix shape mismatch in elementwise operation");
+        Matrix out = makeMatrix(a.rows, a.cols);
+        simd::binary(op, a.values(), b.values(), out.data->data(), a.data->size());
+        return out;
+    }
+    if (std::holds_alternative<Matrix>(left) && std::holds_alternative<double>(right)) {
+        const auto& a = std::get<Matrix>(left);
+        Matrix out = makeMatrix(a.rows, a.cols);
+        simd::binaryScalar(op, a.values(), std::get<double>(right), out.data->data(), a.data->size());
+        return out;
+    }
+    if (std::holds_alternative<double>(left) && std::holds_alternative<Matrix>(right)) {
+        const auto& b = std::get<Matrix>(right);
+        Matrix out = makeMatrix(b.rows, b.cols);
+        simd::scalarBinary(op, std::get<double>(left), b.values(), out.data->data(), b.data->size());
+        return out;
+    }
+    throw std::runtime_error("Invalid operands for elementwise matrix operation");
+}
+
+Matrix matrixFromRows(const Value& rows) {
+    if (!isPack(rows)) throw std::runtime_error("matrix() expects a pack of rows");
+    size_t rowCount = packSize(rows);
+    Matrix m;
+    std::vector<double> scratch;
+    for (size_t r = 0; r < rowCount; ++r) {
+        size_t n = 0;
+        const double* row = numericData(packAt(rows, r), scratch, n);
+        if (r == 0) m = makeMatrix(rowCount, n);
+        else if (n != m.cols) throw std::runtime_error("matrix() rows must have equal length");
+        std::copy(row, row + n, m.data->begin() + r * n);
+    }
+    if (rowCount == 0) m = makeMatrix(0, 0);
+    return m;
+}
+
+void printValue(std::ostream& os, const Value& v) {
+    if (std::holds_alternative<double>(v)) {
+        os << std::get<double>(v);
+    } else if (std::holds_alternative<std::string>(v)) {
+        os << std::get<std::string>(v);
+    } else if (isPack(v)) {
+        os << "[";
+        size_t n = packSize(v);
+        for (size_t i = 0; i < n; ++i) {
+            if (i) os << ", ";
+            printValue(os, packAt(v, i));
+        }
+        os << "]";
+    } else if (std::holds_alternative<Matrix>(v)) {
+        const auto& m = std::get<Matrix>(v);
+        os << "[";
+        for (size_t r = 0; r < m.rows; ++r) {
+            os << (r ? ", [" : "[");
+            for (size_t c = 0; c < m.cols; ++c) os << (c ? ", " : "") << m.at(r, c);
+            os << "]";
+        }
+        os << "]";
+    } else if (std::holds_alternative<TextView>(v)) {
+        os << std::get<TextView>(v).view();
+    } else if (std::holds_alternative<Map>(v)) {
+        const auto& m = std::get<Map>(v);
+        os << "{";
+        for (size_t i = 0; i < m.size(); ++i) {
+            const auto& [key, value] = m.data->entries[i];
+            os << (i ? ", \"" : "\"") << key << "\": ";
+            if (isText(*value)) os << "\"" << textOf(*value) << "\"";
+            else printValue(os, *value);
+        }
+        os << "}";
+    } else if (std::holds_alternative<SequencePtr>(v)) {
+        os << "<" << std::get<SequencePtr>(v)->describe() << ">";
+    } else if (std::holds_alternative<FunctionRef>(v)) {
+        os << "<func " << std::get<FunctionRef>(v).func->name << ">";
+    } else if (std::holds_alternative<std::shared_ptr<Task>>(v)) {
+        os << "<task " << std::get<std::shared_ptr<Task>>(v)->func->name << ">";
+    }
+}
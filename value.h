@@ -0,0 +1,138 @@
+#pragma once
+#include "budget.h"
+#include "matrix.h"
+#include "simd.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+struct Value;
+struct Task;
+class MappedFile;
+class Interpreter;
+class Program;
+struct FunctionNode;
+
+// Bytes counted against the memory budget for n element slots of a generic pack
+size_t slotBytes(size_t n);
+
+// Generic pack: any mix of values. Like a numeric pack it is a view, an offset and a
+// length into element storage that copies and slices share until one of them is written.
+struct Pack {
+    struct Elements : std::vector<std::shared_ptr<Value>> {
+        using std::vector<std::shared_ptr<Value>>::vector;
+        budget::Charge charge{slotBytes(capacity())};
+    };
+    std::shared_ptr<Elements> data = std::make_shared<Elements>();
+    size_t offset = 0;
+    size_t length = 0;
+    size_t size() const { return length; }
+    const std::shared_ptr<Value>& operator[](size_t i) const { return (*data)[offset + i]; }
+    Elements::const_iterator begin() const { return data->cbegin() + static_cast<std::ptrdiff_t>(offset); }
+    Elements::const_iterator end() const { return begin() + static_cast<std::ptrdiff_t>(length); }
+    void reserve(size_t n);
+    void push_back(std::shared_ptr<Value> element);
+    // Unshares the elements before an in-place write; returns the first element of the view
+    std::shared_ptr<Value>* mutableData();
+};
+
+// Where a numeric pack's doubles live: its own vector, or a pack file mapped by open_pack
+struct NumStorage {
+    std::vector<double> owned;
+    std::shared_ptr<const MappedFile> file; // keeps a mapped pack's pages alive
+    double* values = nullptr;
+    size_t size = 0;
+    bool readOnly = false;
+    budget::Charge charge; // owned bytes; mapped pages are not counted
+};
+
+// Numeric pack: contiguous doubles, a view of offset and length into storage shared by
+// copies and slices until one of them is written
+struct NumPack {
+    std::shared_ptr<NumStorage> data;
+    size_t offset = 0;
+    size_t length = 0;
+    size_t size() const { return length; }
+    const double* values() const { return data->values + offset; }
+    // Unshares the storage before an in-place write. A copy-on-write mapping is written in
+    // place; a read-only one is first copied into memory.
+    double* mutableData();
+};
+
+// Text inside a mapped file, from read() or lines(). It keeps the mapping alive and is
+// used like a string; operators other than == and != work on a copy.
+struct TextView {
+    std::shared_ptr<const MappedFile> file;
+    const char* data;
+    size_t size;
+    std::string_view view() const { return {data, size}; }
+};
+
+// String-keyed map; keys keep insertion order. Copies share entries until one is written.
+struct Map {
+    struct Data {
+        std::vector<std::pair<std::string, std::shared_ptr<Value>>> entries;
+        std::unordered_map<std::string, size_t> index;
+        budget::Charge charge;
+    };
+    std::shared_ptr<Data> data;
+    size_t size() const { return data->entries.size(); }
+    const Value* find(std::string_view key) const;
+    // Unshares the entries before an in-place write
+    Data& mutableData();
+    void set(const std::string& key, Value value);
+};
+
+// A lazily produced series of values that for-in consumes one element at a time.
+// Elements are made on demand and never held together; a sequence can be walked again.
+struct Sequence {
+    virtual ~Sequence() = default;
+    // Calls f with each element in order until f returns false
+    virtual void forEach(Interpreter& interp, const std::function<bool(Value)>& f) const = 0;
+    virtual std::string describe() const = 0;
+};
+
+using SequencePtr = std::shared_ptr<const Sequence>;
+
+// A named function used as a value, e.g. the f in map(xs, f). It keeps the program that
+// owns the function alive.
+struct FunctionRef {
+    const FunctionNode* func;
+    std::shared_ptr<const Program> program;
+};
+
+// Task handles (from spawn) and sequences are shared by every copy of the value
+struct Value : std::variant<double, std::string, Pack, NumPack, Matrix, std::shared_ptr<Task>, TextView, Map, SequencePtr, FunctionRef> {
+    using variant::variant;
+};
+
+NumPack makeNumPack(std::vector<double> values);
+bool isPack(const Value& v);
+bool isText(const Value& v); // string or TextView
+std::string_view textOf(const Value& v);
+// Numbers are true when non-zero, text when non-empty
+bool isTrue(const Value& v);
+Map makeMap();
+// Calls f with each line of the file as a TextView, without the line break; stops early
+// when f returns false. Pages already read are released as the scan moves on.
+void forEachLine(const std::shared_ptr<const MappedFile>& file, const std::function<bool(const TextView&)>& f);
+size_t packSize(const Value& v);
+// v[begin:end] for packs and text, sharing v's storage; the bounds are clamped to v
+Value sliceValue(const Value& v, size_t begin, size_t end);
+Value packAt(const Value& v, size_t i);
+// Contiguous doubles of a pack; generic packs of numbers are gathered into scratch.
+// Throws if the pack holds anything but numbers.
+const double* numericData(const Value& v, std::vector<double>& scratch, size_t& n);
+// Elementwise arithmetic where at least one side is a pack and the other a pack or number
+Value packArith(simd::Op op, const Value& left, const Value& right);
+// Elementwise arithmetic where at least one side is a matrix and the other a matrix or number
+Value matrixArith(simd::Op op, const Value& left, const Value& right);
+// Builds a matrix from a pack of equally long numeric packs
+Matrix matrixFromRows(const Value& rows);
+void printValue(std::ostream& os, const Value& v);
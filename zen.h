@@ -0,0 +1,32 @@
+#pragma once
+// Embedding API.
+//
+// Compile a script once and share the Program between threads; give each thread its own
+// Context to run it in:
+//
+//     auto program = zen::compileFile("handler.mylang");
+//     // on each request thread
+//     std::ostringstream out;
+//     zen::Context ctx(program, out);
+//     ctx.setLimits({1'000'000, 64 << 20, 250}); // fuel, memory bytes, deadline ms
+//     ctx.setVar("request", zen::Value(body));
+//     ctx.run();
+//     zen::Value reply = ctx.call("respond", {zen::Value(1.0)});
+//
+// A Context must not be used by two threads at once. Programs are never modified after
+// compile() and need no locking. A script that runs out of fuel, memory, time or stack
+// (nested calls past Limits::callDepth or near the end of the native stack) throws
+// zen::BudgetExceeded, whose kind says which.
+#include "interpreter.h"
+#include "program.h"
+#include "value.h"
+
+namespace zen {
+using ::BudgetExceeded;
+using Limits = budget::Limits;
+using ::Program;
+using ::Value;
+using Context = ::Interpreter;
+using ::compile;
+using ::compileFile;
+} // namespace zen
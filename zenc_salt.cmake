@@ -0,0 +1,18 @@
+# Writes OUTPUT, a header defining ZENC_SOURCE_HASH as the SHA-256 of the SOURCES that
+# decide what a .zenc cache holds. The header is rewritten only when the hash changes,
+# so only edits to those sources rebuild ast_cache.cpp, and the same sources always give
+# the same build.
+set(text "")
+foreach(source ${SOURCES})
+    file(SHA256 ${source} hash)
+    get_filename_component(name ${source} NAME)
+    string(APPEND text "${name} ${hash}\n")
+endforeach()
+string(SHA256 hash "${text}")
+set(header "// Generated by zenc_salt.cmake\n#define ZENC_SOURCE_HASH \"${hash}\"\n")
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} old)
+endif()
+if(NOT old STREQUAL header)
+    file(WRITE ${OUTPUT} "${header}")
+endif()